@@ -68,7 +68,9 @@
 #include <conio.h>
 #endif
 
+#include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/mem.h"
 #include "libavutil/time.h"
@@ -78,6 +80,7 @@
 #include "libavdevice/avdevice.h"
 
 #include "cmdutils.h"
+#include "fopen_utf8.h"
 #include "ffmpeg.h"
 #include "ffmpeg_sched.h"
 #include "ffmpeg_utils.h"
@@ -140,6 +143,9 @@ static volatile int received_nb_signals = 0;
 static atomic_int transcode_init_done = 0;
 static volatile int ffmpeg_exited = 0;
 static int64_t copy_ts_first_pts = AV_NOPTS_VALUE;
+static AVBufferPool *frame_data_pool;
+static int64_t last_report_time = -1;
+static int first_report = 1;
 
 static void
 sigterm_handler(int sig)
@@ -307,19 +313,16 @@ static int decode_interrupt_cb(void *ctx)
 
 const AVIOInterruptCB int_cb = { decode_interrupt_cb, NULL };
 
-static void ffmpeg_cleanup(int ret)
+/* free everything that belongs to a single transcoding job */
+static void job_cleanup(int ret)
 {
     if ((print_graphs || print_graphs_file) && nb_output_files > 0)
         print_filtergraphs(filtergraphs, nb_filtergraphs, input_files, nb_input_files, output_files, nb_output_files);
 
-    if (do_benchmark) {
-        int64_t maxrss = getmaxrss() / 1024;
-        av_log(NULL, AV_LOG_INFO, "bench: maxrss=%"PRId64"KiB\n", maxrss);
-    }
-
     for (int i = 0; i < nb_filtergraphs; i++)
         fg_free(&filtergraphs[i]);
     av_freep(&filtergraphs);
+    nb_filtergraphs = 0;
 
     for (int i = 0; i < nb_output_files; i++)
         of_free(&output_files[i]);
@@ -330,35 +333,54 @@ static void ffmpeg_cleanup(int ret)
     for (int i = 0; i < nb_decoders; i++)
         dec_free(&decoders[i]);
     av_freep(&decoders);
+    nb_decoders = 0;
 
     if (vstats_file) {
         if (fclose(vstats_file))
             av_log(NULL, AV_LOG_ERROR,
                    "Error closing vstats file, loss of information possible: %s\n",
                    av_err2str(AVERROR(errno)));
+        vstats_file = NULL;
     }
-    av_freep(&vstats_filename);
     of_enc_stats_close();
 
     hw_device_free_all();
-
-    av_freep(&filter_nbthreads);
-
-    av_freep(&print_graphs_file);
-    av_freep(&print_graphs_format);
+    filter_hw_device = NULL;
 
     av_freep(&input_files);
     av_freep(&output_files);
+    nb_input_files  = 0;
+    nb_output_files = 0;
 
+    avio_closep(&progress_avio);
+
+    reset_global_options();
     uninit_opts();
 
+    if (!received_sigterm && ret && atomic_load(&transcode_init_done))
+        av_log(NULL, AV_LOG_INFO, "Conversion failed!\n");
+
+    atomic_store(&transcode_init_done, 0);
+    atomic_store(&nb_output_dumped, 0);
+    copy_ts_first_pts = AV_NOPTS_VALUE;
+    last_report_time  = -1;
+    first_report      = 1;
+}
+
+static void ffmpeg_cleanup(int ret)
+{
+    if (do_benchmark) {
+        int64_t maxrss = getmaxrss() / 1024;
+        av_log(NULL, AV_LOG_INFO, "bench: maxrss=%"PRId64"KiB\n", maxrss);
+    }
+
+    av_buffer_pool_uninit(&frame_data_pool);
+
     avformat_network_deinit();
 
     if (received_sigterm) {
         av_log(NULL, AV_LOG_INFO, "Exiting normally, received signal %d.\n",
                (int) received_sigterm);
-    } else if (ret && atomic_load(&transcode_init_done)) {
-        av_log(NULL, AV_LOG_INFO, "Conversion failed!\n");
     }
     term_exit();
     ffmpeg_exited = 1;
@@ -405,6 +427,21 @@ static void frame_data_free(void *opaque, uint8_t *data)
     av_free(data);
 }
 
+static AVBufferRef *frame_data_alloc(void *opaque, size_t size)
+{
+    FrameData *fd = av_mallocz(sizeof(*fd));
+    AVBufferRef *buf;
+
+    if (!fd)
+        return NULL;
+
+    buf = av_buffer_create((uint8_t *)fd, sizeof(*fd), frame_data_free, NULL, 0);
+    if (!buf)
+        av_freep(&fd);
+
+    return buf;
+}
+
 static int frame_data_ensure(AVBufferRef **dst, int writable)
 {
     AVBufferRef *src = *dst;
@@ -412,18 +449,18 @@ static int frame_data_ensure(AVBufferRef **dst, int writable)
     if (!src || (writable && !av_buffer_is_writable(src))) {
         FrameData *fd;
 
-        fd = av_mallocz(sizeof(*fd));
-        if (!fd)
-            return AVERROR(ENOMEM);
-
-        *dst = av_buffer_create((uint8_t *)fd, sizeof(*fd),
-                                frame_data_free, NULL, 0);
+        // every demuxed packet gets one, so avoid allocating them each time
+        *dst = av_buffer_pool_get(frame_data_pool);
         if (!*dst) {
             av_buffer_unref(&src);
-            av_freep(&fd);
             return AVERROR(ENOMEM);
         }
 
+        // pooled entries keep the contents from their previous use
+        fd = (FrameData *)(*dst)->data;
+        avcodec_parameters_free(&fd->par_enc);
+        memset(fd, 0, sizeof(*fd));
+
         if (src) {
             const FrameData *fd_src = (const FrameData *)src->data;
 
@@ -552,15 +589,14 @@ void update_benchmark(const char *fmt, ...)
     }
 }
 
-static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time, int64_t pts)
+static void print_report(Scheduler *sch, int is_last_report,
+                         int64_t timer_start, int64_t cur_time, int64_t pts)
 {
     AVBPrint buf, buf_script;
     int64_t total_size = of_filesize(output_files[0]);
     int vid;
     double bitrate;
     double speed;
-    static int64_t last_time = -1;
-    static int first_report = 1;
     uint64_t nb_frames_dup = 0, nb_frames_drop = 0;
     int mins, secs, ms, us;
     int64_t hours;
@@ -572,13 +608,13 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         return;
 
     if (!is_last_report) {
-        if (last_time == -1) {
-            last_time = cur_time;
+        if (last_report_time == -1) {
+            last_report_time = cur_time;
         }
-        if (((cur_time - last_time) < stats_period && !first_report) ||
+        if (((cur_time - last_report_time) < stats_period && !first_report) ||
             (first_report && atomic_load(&nb_output_dumped) < nb_output_files))
             return;
-        last_time = cur_time;
+        last_report_time = cur_time;
     }
 
     t = (cur_time-timer_start) / 1000000.0;
@@ -698,6 +734,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     av_bprint_finalize(&buf, NULL);
 
     if (progress_avio) {
+        if (progress_sched)
+            sch_print_stats(sch, &buf_script);
         av_bprintf(&buf_script, "progress=%s\n",
                    is_last_report ? "end" : "continue");
         avio_write(progress_avio, buf_script.str,
@@ -878,6 +916,9 @@ static int transcode(Scheduler *sch)
 
     atomic_store(&transcode_init_done, 1);
 
+    if (progress_sched)
+        sch_enable_stats(sch);
+
     ret = sch_start(sch);
     if (ret < 0)
         return ret;
@@ -897,7 +938,7 @@ static int transcode(Scheduler *sch)
                 break;
 
         /* dump report by using the output first video and audio streams */
-        print_report(0, timer_start, cur_time, transcode_ts);
+        print_report(sch, 0, timer_start, cur_time, transcode_ts);
     }
 
     ret = sch_stop(sch, &transcode_ts);
@@ -911,7 +952,7 @@ static int transcode(Scheduler *sch)
     term_exit();
 
     /* dump report by using the first video and audio streams */
-    print_report(1, timer_start, av_gettime_relative(), transcode_ts);
+    print_report(sch, 1, timer_start, av_gettime_relative(), transcode_ts);
 
     return ret;
 }
@@ -960,27 +1001,14 @@ static int64_t getmaxrss(void)
 #endif
 }
 
-int main(int argc, char **argv)
+/* run a single transcoding job described by the given command line */
+static int run_job(int argc, char **argv)
 {
     Scheduler *sch = NULL;
 
     int ret;
     BenchmarkTimeStamps ti;
 
-    init_dynload();
-
-    setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
-
-    av_log_set_flags(AV_LOG_SKIP_REPEATED);
-    parse_loglevel(argc, argv, options);
-
-#if CONFIG_AVDEVICE
-    avdevice_register_all();
-#endif
-    avformat_network_init();
-
-    show_banner(argc, argv, options);
-
     sch = sch_alloc();
     if (!sch) {
         ret = AVERROR(ENOMEM);
@@ -1025,10 +1053,185 @@ finish:
     if (ret == AVERROR_EXIT)
         ret = 0;
 
-    ffmpeg_cleanup(ret);
+    job_cleanup(ret);
 
     sch_free(&sch);
 
+    return ret;
+}
+
+static int read_line(FILE *f, AVBPrint *bp)
+{
+    char buf[1024];
+
+    av_bprint_clear(bp);
+    while (fgets(buf, sizeof(buf), f)) {
+        av_bprintf(bp, "%s", buf);
+        if (bp->len && bp->str[bp->len - 1] == '\n')
+            break;
+    }
+    if (!av_bprint_is_complete(bp))
+        return AVERROR(ENOMEM);
+
+    return bp->len ? 0 : AVERROR_EOF;
+}
+
+/**
+ * Run one job for every line of the manifest given to -batch, each with the
+ * arguments from that line appended to the rest of the command line.
+ */
+static int run_batch(int argc, char **argv, int batch_idx)
+{
+    static const char *const whitespace = " \t\r\n";
+    const char *manifest = argv[batch_idx + 1];
+    char **job_argv = NULL;
+    int nb_base = 0, nb_jobs = 0, nb_failed = 0, line = 0;
+    AVBPrint bp;
+    FILE *f;
+    int ret;
+
+    if (!strcmp(manifest, "-")) {
+        /* the manifest is read from stdin, so it must not be used for
+         * keyboard interaction */
+        f = stdin;
+    } else {
+        f = fopen_utf8(manifest, "r");
+        if (!f) {
+            ret = AVERROR(errno);
+            av_log(NULL, AV_LOG_FATAL, "Error opening batch manifest '%s': %s\n",
+                   manifest, av_err2str(ret));
+            return ret;
+        }
+    }
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    job_argv = av_calloc(argc, sizeof(*job_argv));
+    if (!job_argv) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+    for (int i = 0; i < argc; i++)
+        if (i != batch_idx && i != batch_idx + 1)
+            job_argv[nb_base++] = argv[i];
+
+    while ((ret = read_line(f, &bp)) >= 0 && !received_nb_signals) {
+        const char *p = bp.str;
+        int64_t job_start;
+        double job_time;
+        int job_argc = nb_base, job_ret;
+
+        line++;
+
+        while (*(p += strspn(p, whitespace)) && *p != '#') {
+            char **tmp = av_realloc_array(job_argv, job_argc + 2, sizeof(*job_argv));
+            char *arg;
+
+            if (!tmp) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            job_argv = tmp;
+
+            arg = av_get_token(&p, whitespace);
+            if (!arg) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            job_argv[job_argc++] = arg;
+        }
+        if (ret < 0) {
+            for (int i = nb_base; i < job_argc; i++)
+                av_freep(&job_argv[i]);
+            goto finish;
+        }
+        // blank line or comment
+        if (job_argc == nb_base)
+            continue;
+        job_argv[job_argc] = NULL;
+
+        av_log(NULL, AV_LOG_VERBOSE, "Starting batch job %d (line %d)\n",
+               nb_jobs, line);
+
+        // the global options were reset by the previous job
+        if (f == stdin)
+            stdin_interaction = 0;
+
+        job_start = av_gettime_relative();
+        job_ret = run_job(job_argc, job_argv);
+        job_time = (av_gettime_relative() - job_start) / 1000000.0;
+
+        if (job_ret < 0)
+            av_log(NULL, AV_LOG_ERROR, "Batch job %d (line %d) failed after %.3fs: %s\n",
+                   nb_jobs, line, job_time, av_err2str(job_ret));
+        else if (job_ret)
+            av_log(NULL, AV_LOG_ERROR, "Batch job %d (line %d) failed after %.3fs: exit code %d\n",
+                   nb_jobs, line, job_time, job_ret);
+        else
+            av_log(NULL, AV_LOG_INFO, "Batch job %d (line %d) succeeded after %.3fs\n",
+                   nb_jobs, line, job_time);
+
+        for (int i = nb_base; i < job_argc; i++)
+            av_freep(&job_argv[i]);
+
+        nb_failed += !!job_ret;
+        nb_jobs++;
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+    av_log(NULL, nb_failed ? AV_LOG_ERROR : AV_LOG_INFO,
+           "Batch finished: %d jobs, %d failed\n", nb_jobs, nb_failed);
+
+finish:
+    if (ret < 0)
+        av_log(NULL, AV_LOG_FATAL, "Error reading batch manifest '%s' (line %d): %s\n",
+               manifest, line, av_err2str(ret));
+
+    av_freep(&job_argv);
+    av_bprint_finalize(&bp, NULL);
+    if (f != stdin)
+        fclose(f);
+
+    return received_nb_signals ? 255 :
+           ret < 0             ? ret :
+           nb_failed           ?   1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret, batch_idx;
+
+    init_dynload();
+
+    setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
+
+    av_log_set_flags(AV_LOG_SKIP_REPEATED);
+    parse_loglevel(argc, argv, options);
+
+#if CONFIG_AVDEVICE
+    avdevice_register_all();
+#endif
+    avformat_network_init();
+
+    show_banner(argc, argv, options);
+
+    frame_data_pool = av_buffer_pool_init2(sizeof(FrameData), NULL,
+                                           frame_data_alloc, NULL);
+    if (!frame_data_pool) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    batch_idx = locate_option(argc, argv, options, "batch");
+    if (batch_idx && batch_idx + 1 < argc)
+        ret = run_batch(argc, argv, batch_idx);
+    else
+        ret = run_job(argc, argv);
+
+finish:
+    ffmpeg_cleanup(ret);
+
     av_log(NULL, AV_LOG_VERBOSE, "\n");
     av_log(NULL, AV_LOG_VERBOSE, "Exiting with exit code %d\n", ret);
 
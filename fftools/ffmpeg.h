@@ -193,6 +193,8 @@ typedef struct OptionsContext {
     float mux_preload;
     float mux_max_delay;
     float shortest_buf_duration;
+    int64_t shortest_buf_size;
+    float shortest_sparse_timeout;
     int shortest;
     int bitexact;
 
@@ -229,11 +231,13 @@ typedef struct OptionsContext {
     SpecifierOptList copy_initial_nonkeyframes;
     SpecifierOptList copy_prior_start;
     SpecifierOptList filters;
+    SpecifierOptList filter_stages;
 #if FFMPEG_OPT_FILTER_SCRIPT
     SpecifierOptList filter_scripts;
 #endif
     SpecifierOptList reinit_filters;
     SpecifierOptList drop_changed;
+    SpecifierOptList scale_changed;
     SpecifierOptList fix_sub_duration;
     SpecifierOptList fix_sub_duration_heartbeat;
     SpecifierOptList canvas_sizes;
@@ -265,6 +269,7 @@ enum IFilterFlags {
     IFILTER_FLAG_CFR            = (1 << 2),
     IFILTER_FLAG_CROP           = (1 << 3),
     IFILTER_FLAG_DROPCHANGED    = (1 << 4),
+    IFILTER_FLAG_SCALECHANGED   = (1 << 5),
 };
 
 typedef struct InputFilterOptions {
@@ -322,6 +327,10 @@ typedef struct OutputFilterOptions {
 
     int64_t             nb_threads;
 
+    // Number of pipeline stages a simple filtergraph should be split into,
+    // each running in its own thread.
+    int                 nb_stages;
+
     // A combination of OFilterFlags.
     unsigned            flags;
 
@@ -733,11 +742,15 @@ extern int print_stats;
 extern int64_t stats_period;
 extern int stdin_interaction;
 extern AVIOContext *progress_avio;
+extern int progress_sched;
 extern float max_error_rate;
 
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
 extern int filter_buffered_frames;
+extern char *filter_fuse;
+extern char *filter_profile;
+extern int64_t filter_pool_size;
 extern int vstats_version;
 extern int print_graphs;
 extern char *print_graphs_file;
@@ -808,6 +821,11 @@ void fg_send_command(FilterGraph *fg, double time, const char *target,
                      const char *command, const char *arg, int all_filters);
 
 int ffmpeg_parse_options(int argc, char **argv, Scheduler *sch);
+/**
+ * Restore the default values of the global options, so that the options of
+ * a batch job do not apply to the following ones.
+ */
+void reset_global_options(void);
 
 void enc_stats_write(OutputStream *ost, EncStats *es,
                      const AVFrame *frame, const AVPacket *pkt,
@@ -1569,8 +1569,14 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
     dp->dec_ctx->get_buffer2           = get_buffer;
     dp->dec_ctx->pkt_timebase          = o->time_base;
 
-    if (!av_dict_get(*dec_opts, "threads", NULL, 0))
-        av_dict_set(dec_opts, "threads", "auto", 0);
+    if (!av_dict_get(*dec_opts, "threads", NULL, 0)) {
+        int threads = sch_thread_share(dp->sch);
+
+        if (threads)
+            av_dict_set_int(dec_opts, "threads", threads, 0);
+        else
+            av_dict_set(dec_opts, "threads", "auto", 0);
+    }
 
     ret = hw_device_setup_for_decode(dp, codec, o->hwaccel_device);
     if (ret < 0) {
@@ -68,6 +68,7 @@ typedef struct DemuxStream {
     int                      autorotate;
     int                      apply_cropping;
     int                      drop_changed;
+    int                      scale_changed;
 
 
     int                      wrap_correction_done;
@@ -1110,7 +1111,8 @@ int ist_filter_add(InputStream *ist, InputFilter *ifilter, int is_simple,
 
     opts->flags |= IFILTER_FLAG_AUTOROTATE * !!(ds->autorotate) |
                    IFILTER_FLAG_REINIT     * !!(ds->reinit_filters) |
-                   IFILTER_FLAG_DROPCHANGED* !!(ds->drop_changed);
+                   IFILTER_FLAG_DROPCHANGED* !!(ds->drop_changed) |
+                   IFILTER_FLAG_SCALECHANGED * !!(ds->scale_changed);
 
     return 0;
 }
@@ -1432,6 +1434,14 @@ static int ist_add(const OptionsContext *o, Demuxer *d, AVStream *st, AVDictiona
         ds->reinit_filters = 0;
     }
 
+    ds->scale_changed = 0;
+    opt_match_per_stream_int(ist, &o->scale_changed, ic, st, &ds->scale_changed);
+
+    if (ds->scale_changed && ds->drop_changed) {
+        av_log(ist, AV_LOG_ERROR, "drop_changed and scale_changed both enabled. These are mutually exclusive.\n");
+        return AVERROR(EINVAL);
+    }
+
     ist->user_set_discard = AVDISCARD_NONE;
 
     if ((o->video_disable && ist->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) ||
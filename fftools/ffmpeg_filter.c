@@ -40,6 +40,8 @@
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
 
+#include "libswscale/swscale.h"
+
 // FIXME private header, used for mid_pred()
 #include "libavcodec/mathops.h"
 
@@ -61,6 +63,11 @@ typedef struct FilterGraphPriv {
 
     int              nb_threads;
 
+    // for simple filtergraphs split into pipeline stages, the graphs running
+    // the stages that precede this one, in processing order
+    FilterGraph    **stages;
+    int              nb_stages;
+
     // frame for temporarily holding output from the filtergraph
     AVFrame         *frame;
     // frame for sending output to the encoder
@@ -118,6 +125,12 @@ typedef struct InputFilterPriv {
     int                 drop_warned;
     uint64_t            nb_dropped;
 
+    // a scale filter pinned to the configured parameters follows the buffer
+    // source, see IFILTER_FLAG_SCALECHANGED
+    int                 scaler;
+    int                 scale_warned;
+    uint64_t            nb_scaled;
+
     // parameters configured for this input
     int                 format;
 
@@ -942,14 +955,17 @@ static int ifilter_bind_fg(InputFilterPriv *ifp, FilterGraph *fg_src, int out_id
 
     memset(&opts, 0, sizeof(opts));
 
-    snprintf(name, sizeof(name), "fg:%d:%d", fgp->fg.index, ifp->ifilter.index);
+    if (fgp->is_simple)
+        av_strlcpy(name, fgp->log_name, sizeof(name));
+    else
+        snprintf(name, sizeof(name), "fg:%d:%d", fgp->fg.index, ifp->ifilter.index);
     opts.name = name;
 
     ret = ofilter_bind_ifilter(ofilter_src, ifp, &opts);
     if (ret < 0)
         return ret;
 
-    ret = sch_connect(fgp->sch, SCH_FILTER_OUT(fg_src->index, out_idx),
+    ret = sch_connect(fgp->sch, SCH_FILTER_OUT(fgp_from_fg(fg_src)->sch_idx, out_idx),
                                 SCH_FILTER_IN(fgp->sch_idx, ifp->ifilter.index));
     if (ret < 0)
         return ret;
@@ -994,6 +1010,10 @@ void fg_free(FilterGraph **pfg)
         return;
     fgp = fgp_from_fg(fg);
 
+    for (int i = 0; i < fgp->nb_stages; i++)
+        fg_free(&fgp->stages[i]);
+    av_freep(&fgp->stages);
+
     for (int j = 0; j < fg->nb_inputs; j++) {
         InputFilter *ifilter = fg->inputs[j];
         InputFilterPriv *ifp = ifp_from_ifilter(ifilter);
@@ -1193,6 +1213,214 @@ fail:
     return 0;
 }
 
+static int filter_desc_is_metadata_only(const char *desc)
+{
+    const AVFilter *f;
+    char name[128];
+    size_t len;
+
+    desc += strspn(desc, " \n\t\r");
+    len   = strcspn(desc, "=@ \n\t\r,");
+    av_strlcpy(name, desc, FFMIN(len + 1, sizeof(name)));
+
+    f = avfilter_get_by_name(name);
+    return f && (f->flags & AVFILTER_FLAG_METADATA_ONLY);
+}
+
+/**
+ * Split the description of a simple filtergraph consisting of a single
+ * linear chain into at most nb_stages consecutive sub-chains.
+ *
+ * Filters that process frame data are distributed evenly among the stages,
+ * filters that only modify frame metadata stay in the stage of the filter
+ * preceding them.
+ *
+ * @return number of stages, with their descriptions written to *pstages;
+ *         0 if the description cannot be split; a negative error code on
+ *         failure
+ */
+static int graph_split_stages(const char *desc, int nb_stages, char ***pstages)
+{
+    const char **starts = NULL;
+    char       **stages = NULL;
+    int         *stage  = NULL;
+    int nb_filters = 1, nb_heavy = 0, heavy = 0, quoted = 0, ret = 0;
+
+    *pstages = NULL;
+
+    // only linear chains without any link labels can be split
+    for (const char *p = desc; *p; p++) {
+        if (quoted)
+            quoted = *p != '\'';
+        else if (*p == '\\' && p[1])
+            p++;
+        else if (*p == '\'')
+            quoted = 1;
+        else if (*p == ';' || *p == '[')
+            return 0;
+        else if (*p == ',')
+            nb_filters++;
+    }
+
+    if (nb_filters < 2)
+        return 0;
+
+    starts = av_calloc(nb_filters + 1, sizeof(*starts));
+    stage  = av_calloc(nb_filters,     sizeof(*stage));
+    if (!starts || !stage) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    nb_filters = 0;
+    starts[nb_filters++] = desc;
+    for (const char *p = desc; *p; p++) {
+        if (quoted)
+            quoted = *p != '\'';
+        else if (*p == '\\' && p[1])
+            p++;
+        else if (*p == '\'')
+            quoted = 1;
+        else if (*p == ',')
+            starts[nb_filters++] = p + 1;
+    }
+    // as if there was a separator after the last filter
+    starts[nb_filters] = desc + strlen(desc) + 1;
+
+    for (int i = 0; i < nb_filters; i++) {
+        stage[i] = !filter_desc_is_metadata_only(starts[i]);
+        nb_heavy += stage[i];
+    }
+
+    nb_stages = FFMIN(nb_stages, nb_heavy);
+    if (nb_stages < 2)
+        goto finish;
+
+    for (int i = 0; i < nb_filters; i++) {
+        if (stage[i])
+            stage[i] = (int64_t)heavy++ * nb_stages / nb_heavy;
+        else
+            stage[i] = i ? stage[i - 1] : 0;
+    }
+
+    stages = av_calloc(nb_stages, sizeof(*stages));
+    if (!stages) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    for (int i = 0, first = 0; i < nb_filters; i++) {
+        if (i < nb_filters - 1 && stage[i + 1] == stage[i])
+            continue;
+
+        stages[stage[i]] = av_strndup(starts[first],
+                                      starts[i + 1] - starts[first] - 1);
+        if (!stages[stage[i]]) {
+            ret = AVERROR(ENOMEM);
+            goto finish;
+        }
+        first = i + 1;
+    }
+
+    *pstages = stages;
+    stages   = NULL;
+    ret      = nb_stages;
+
+finish:
+    if (stages) {
+        for (int i = 0; i < nb_stages; i++)
+            av_freep(&stages[i]);
+        av_freep(&stages);
+    }
+    av_freep(&starts);
+    av_freep(&stage);
+    return ret;
+}
+
+static int fg_simple_check(FilterGraph *fg, enum AVMediaType type)
+{
+    if (fg->nb_inputs != 1 || fg->nb_outputs != 1) {
+        av_log(fg, AV_LOG_ERROR, "Simple filtergraph '%s' was expected "
+               "to have exactly 1 input and 1 output. "
+               "However, it had %d input(s) and %d output(s). Please adjust, "
+               "or use a complex filtergraph (-filter_complex) instead.\n",
+               fg->graph_desc, fg->nb_inputs, fg->nb_outputs);
+        return AVERROR(EINVAL);
+    }
+    if (fg->outputs[0]->type != type) {
+        av_log(fg, AV_LOG_ERROR, "Filtergraph has a %s output, cannot connect "
+               "it to %s output stream\n",
+               av_get_media_type_string(fg->outputs[0]->type),
+               av_get_media_type_string(type));
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+static int fg_create_stages(FilterGraphPriv *fgp, InputStream *ist,
+                            char **stage_desc, int nb_stages,
+                            const OutputFilterOptions *opts)
+{
+    FilterGraph *fg = &fgp->fg;
+    int ret;
+
+    fgp->stages = av_calloc(nb_stages - 1, sizeof(*fgp->stages));
+    if (!fgp->stages)
+        return AVERROR(ENOMEM);
+    fgp->nb_stages = nb_stages - 1;
+
+    for (int i = 0; i < fgp->nb_stages; i++) {
+        FilterGraphPriv *stage;
+
+        ret = fg_create(&fgp->stages[i], stage_desc[i], fgp->sch);
+        stage_desc[i] = NULL;
+        if (ret < 0)
+            return ret;
+        stage = fgp_from_fg(fgp->stages[i]);
+
+        stage->is_simple = 1;
+        if (opts->nb_threads >= 0)
+            stage->nb_threads = opts->nb_threads;
+
+        av_strlcpy(stage->log_name, fgp->log_name, sizeof(stage->log_name));
+        av_strlcatf(stage->log_name, sizeof(stage->log_name), ":s%d", i);
+
+        ret = fg_simple_check(&stage->fg, ist->par->codec_type);
+        if (ret < 0)
+            return ret;
+
+        ret = i ? ifilter_bind_fg(ifp_from_ifilter(stage->fg.inputs[0]),
+                                  fgp->stages[i - 1], 0) :
+                  ifilter_bind_ist(stage->fg.inputs[0], ist, opts->vs);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = ifilter_bind_fg(ifp_from_ifilter(fg->inputs[0]),
+                          fgp->stages[fgp->nb_stages - 1], 0);
+    if (ret < 0)
+        return ret;
+
+    // scaler/resampler options apply to the whole chain
+    for (int i = 0; i < fgp->nb_stages; i++) {
+        OutputFilterPriv *ofp = ofp_from_ofilter(fgp->stages[i]->outputs[0]);
+
+        ret = av_dict_copy(&ofp->sws_opts, opts->sws_opts, 0);
+        if (ret < 0)
+            return ret;
+
+        ret = av_dict_copy(&ofp->swr_opts, opts->swr_opts, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    av_log(fgp, AV_LOG_VERBOSE, "Split filtergraph into %d stages\n",
+           nb_stages);
+
+    return 0;
+}
+
 int fg_create_simple(FilterGraph **pfg,
                      InputStream *ist,
                      char *graph_desc,
@@ -1202,11 +1430,28 @@ int fg_create_simple(FilterGraph **pfg,
     const enum AVMediaType type = ist->par->codec_type;
     FilterGraph *fg;
     FilterGraphPriv *fgp;
+    char **stage_desc = NULL;
+    int nb_stages = 0;
     int ret;
 
+    if (opts->nb_stages > 1) {
+        nb_stages = graph_split_stages(graph_desc, opts->nb_stages, &stage_desc);
+        if (nb_stages < 0) {
+            av_freep(&graph_desc);
+            return nb_stages;
+        }
+
+        // the last stage is run by the graph created here
+        if (nb_stages) {
+            av_freep(&graph_desc);
+            graph_desc = stage_desc[nb_stages - 1];
+            stage_desc[nb_stages - 1] = NULL;
+        }
+    }
+
     ret = fg_create(pfg, graph_desc, sch);
     if (ret < 0)
-        return ret;
+        goto finish;
     fg  = *pfg;
     fgp = fgp_from_fg(fg);
 
@@ -1215,34 +1460,28 @@ int fg_create_simple(FilterGraph **pfg,
     snprintf(fgp->log_name, sizeof(fgp->log_name), "%cf%s",
              av_get_media_type_string(type)[0], opts->name);
 
-    if (fg->nb_inputs != 1 || fg->nb_outputs != 1) {
-        av_log(fg, AV_LOG_ERROR, "Simple filtergraph '%s' was expected "
-               "to have exactly 1 input and 1 output. "
-               "However, it had %d input(s) and %d output(s). Please adjust, "
-               "or use a complex filtergraph (-filter_complex) instead.\n",
-               graph_desc, fg->nb_inputs, fg->nb_outputs);
-        return AVERROR(EINVAL);
-    }
-    if (fg->outputs[0]->type != type) {
-        av_log(fg, AV_LOG_ERROR, "Filtergraph has a %s output, cannot connect "
-               "it to %s output stream\n",
-               av_get_media_type_string(fg->outputs[0]->type),
-               av_get_media_type_string(type));
-        return AVERROR(EINVAL);
-    }
+    ret = fg_simple_check(fg, type);
+    if (ret < 0)
+        goto finish;
 
-    ret = ifilter_bind_ist(fg->inputs[0], ist, opts->vs);
+    ret = nb_stages ? fg_create_stages(fgp, ist, stage_desc, nb_stages, opts) :
+                      ifilter_bind_ist(fg->inputs[0], ist, opts->vs);
     if (ret < 0)
-        return ret;
+        goto finish;
 
     ret = ofilter_bind_enc(fg->outputs[0], sched_idx_enc, opts);
     if (ret < 0)
-        return ret;
+        goto finish;
 
     if (opts->nb_threads >= 0)
         fgp->nb_threads = opts->nb_threads;
 
-    return 0;
+finish:
+    for (int i = 0; i < nb_stages; i++)
+        av_freep(&stage_desc[i]);
+    av_freep(&stage_desc);
+
+    return ret;
 }
 
 static int fg_complex_bind_input(FilterGraph *fg, InputFilter *ifilter)
@@ -1741,6 +1980,22 @@ static int configure_input_video_filter(FilterGraph *fg, AVFilterGraph *graph,
     desc = av_pix_fmt_desc_get(ifp->format);
     av_assert0(desc);
 
+    /* Frames with other parameters are converted back to the ones the graph
+     * is configured with, so that the graph does not need to be rebuilt. */
+    ifp->scaler = (ifp->opts.flags & IFILTER_FLAG_SCALECHANGED) &&
+                  ifp->type_src == AVMEDIA_TYPE_VIDEO &&
+                  !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL) &&
+                  sws_test_colorspace(ifp->color_space, 1);
+    if (ifp->scaler) {
+        char scale_buf[128];
+        snprintf(scale_buf, sizeof(scale_buf),
+                 "w=%d:h=%d:out_color_matrix=%d:out_range=%d",
+                 ifp->width, ifp->height, ifp->color_space, ifp->color_range);
+        ret = insert_filter(&last_filter, &pad_idx, "scale", scale_buf);
+        if (ret < 0)
+            return ret;
+    }
+
     if ((ifp->opts.flags & IFILTER_FLAG_CROP)) {
         char crop_buf[64];
         snprintf(crop_buf, sizeof(crop_buf), "w=iw-%u-%u:h=ih-%u-%u:x=%u:y=%u",
@@ -1867,8 +2122,27 @@ static int configure_input_filter(FilterGraph *fg, AVFilterGraph *graph,
     }
 }
 
+static void print_filter_profile(FilterGraph *fg, AVFilterGraph *graph)
+{
+    char *dump;
+    int ret;
+
+    if (!filter_profile || !graph || !graph->nb_filters)
+        return;
+
+    ret = avfilter_graph_dump_profile(graph, filter_profile, &dump);
+    if (ret < 0) {
+        av_log(fg, AV_LOG_ERROR, "Error printing the filter profile: %s\n",
+               av_err2str(ret));
+        return;
+    }
+    av_log(fg, AV_LOG_INFO, "Filter profile:\n%s", dump);
+    av_free(dump);
+}
+
 static void cleanup_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
 {
+    print_filter_profile(fg, fgt->graph);
     for (int i = 0; i < fg->nb_outputs; i++)
         fg->outputs[i]->filter = NULL;
     for (int i = 0; i < fg->nb_inputs; i++)
@@ -1927,7 +2201,8 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             ret = av_opt_set_int(fgt->graph, "threads", fgp->nb_threads, 0);
             if (ret < 0)
                 return ret;
-        }
+        } else
+            fgt->graph->nb_threads = sch_thread_share(fgp->sch);
 
         if (av_dict_count(ofp->sws_opts)) {
             ret = av_dict_get_string(ofp->sws_opts,
@@ -1946,7 +2221,8 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             av_free(args);
         }
     } else {
-        fgt->graph->nb_threads = filter_complex_nbthreads;
+        fgt->graph->nb_threads = filter_complex_nbthreads ?
+                                 filter_complex_nbthreads : sch_thread_share(fgp->sch);
     }
 
     if (filter_buffered_frames) {
@@ -1955,6 +2231,28 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             return ret;
     }
 
+    if (filter_pool_size) {
+        ret = av_opt_set_int(fgt->graph, "frame_pool_size", filter_pool_size, 0);
+        if (ret < 0)
+            goto fail;
+    }
+
+    if (filter_fuse) {
+        ret = av_opt_set(fgt->graph, "fuse_filters", filter_fuse, 0);
+        if (ret < 0)
+            goto fail;
+    }
+
+    if (filter_profile) {
+        if (strcmp(filter_profile, "text") && strcmp(filter_profile, "json")) {
+            av_log(fg, AV_LOG_ERROR, "Invalid filter profile format '%s', "
+                   "must be 'text' or 'json'.\n", filter_profile);
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+        fgt->graph->profile = 1;
+    }
+
     hw_device = hw_device_for_filter();
 
     ret = graph_parse(fg, fgt->graph, graph_desc, &inputs, &outputs, hw_device);
@@ -2903,6 +3201,12 @@ static int send_frame(FilterGraph *fg, FilterGraphThread *fgt,
             return 0;
     }
 
+    if (need_reinit == VIDEO_CHANGED && fgt->graph && ifp->scaler) {
+        ifp->nb_scaled++;
+        av_log_once(fg, AV_LOG_INFO, AV_LOG_DEBUG, &ifp->scale_warned, "Avoiding reinit; scaling frame pts: %s bound for %s to %dx%d\n", av_ts2str(frame->pts), ifilter->name, ifp->width, ifp->height);
+        need_reinit = 0;
+    }
+
     if (!(ifp->opts.flags & IFILTER_FLAG_REINIT) && fgt->graph)
         need_reinit = 0;
 
@@ -3001,10 +3305,8 @@ static void fg_thread_set_name(const FilterGraph *fg)
 {
     char name[16];
     if (filtergraph_is_simple(fg)) {
-        OutputFilterPriv *ofp = ofp_from_ofilter(fg->outputs[0]);
-        snprintf(name, sizeof(name), "%cf%s",
-                 av_get_media_type_string(ofp->ofilter.type)[0],
-                 ofp->ofilter.output_name);
+        const FilterGraphPriv *fgp = cfgp_from_cfg(fg);
+        av_strlcpy(name, fgp->log_name, sizeof(name));
     } else {
         snprintf(name, sizeof(name), "fc%d", fg->index);
     }
@@ -3147,6 +3449,8 @@ read_frames:
             av_log(fg, AV_LOG_VERBOSE, "All consumers returned EOF\n");
             if (ifp && ifp->opts.flags & IFILTER_FLAG_DROPCHANGED)
                 av_log(fg, AV_LOG_INFO, "Total changed input frames dropped : %"PRId64"\n", ifp->nb_dropped);
+            if (ifp && ifp->opts.flags & IFILTER_FLAG_SCALECHANGED)
+                av_log(fg, AV_LOG_INFO, "Total changed input frames scaled : %"PRId64"\n", ifp->nb_scaled);
             break;
         } else if (ret < 0) {
             av_log(fg, AV_LOG_ERROR, "Error sending frames to consumers: %s\n",
@@ -3170,6 +3474,7 @@ finish:
 
     if (print_graphs || print_graphs_file)
         print_filtergraph(fg, fgt.graph);
+    print_filter_profile(fg, fgt.graph);
 
     // EOF is normal termination
     if (ret == AVERROR_EOF)
@@ -3187,6 +3492,9 @@ void fg_send_command(FilterGraph *fg, double time, const char *target,
     AVBufferRef *buf;
     FilterCommand *fc;
 
+    for (int i = 0; i < fgp->nb_stages; i++)
+        fg_send_command(fgp->stages[i], time, target, command, arg, all_filters);
+
     fc = av_mallocz(sizeof(*fc));
     if (!fc)
         return;
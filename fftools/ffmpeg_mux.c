@@ -214,7 +214,10 @@ static int write_packet(Muxer *mux, OutputStream *ost, AVPacket *pkt)
     uint64_t frame_num;
     int ret;
 
-    fs = filesize(s->pb);
+    // querying the size of the output may need a system call, so only do it
+    // when enforcing -fs; the write position is good enough for reporting
+    fs = mux->limit_filesize != INT64_MAX ? filesize(s->pb) :
+         s->pb                            ? avio_tell(s->pb) : -1;
     atomic_store(&mux->last_filesize, fs);
     if (fs >= mux->limit_filesize) {
         ret = AVERROR_EOF;
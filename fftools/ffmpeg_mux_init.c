@@ -992,6 +992,9 @@ ost_bind_filter(const Muxer *mux, MuxStream *ms, OutputFilter *ofilter,
     if (ret < 0)
         return ret;
 
+    opt_match_per_stream_int(ost, &o->filter_stages, mux->fc, ost->st,
+                             &opts.nb_stages);
+
     if (ofilter) {
         av_assert0(!filters);
         ost->filter = ofilter;
@@ -2041,7 +2044,8 @@ static int create_streams(Muxer *mux, const OptionsContext *o)
 }
 
 static int setup_sync_queues(Muxer *mux, AVFormatContext *oc,
-                             int64_t buf_size_us, int shortest)
+                             int64_t buf_size_us, int64_t buf_size_bytes,
+                             int64_t sparse_timeout_us, int shortest)
 {
     OutputFile *of = &mux->of;
     int nb_av_enc = 0, nb_audio_fs = 0, nb_interleaved = 0;
@@ -2050,6 +2054,7 @@ static int setup_sync_queues(Muxer *mux, AVFormatContext *oc,
 #define IS_AV_ENC(ost, type)  \
     (ost->enc && (type == AVMEDIA_TYPE_VIDEO || type == AVMEDIA_TYPE_AUDIO))
 #define IS_INTERLEAVED(type) (type != AVMEDIA_TYPE_ATTACHMENT)
+#define IS_SPARSE(type) (type == AVMEDIA_TYPE_SUBTITLE || type == AVMEDIA_TYPE_DATA)
 
     for (int i = 0; i < oc->nb_streams; i++) {
         OutputStream *ost = of->streams[i];
@@ -2086,7 +2091,7 @@ static int setup_sync_queues(Muxer *mux, AVFormatContext *oc,
     if ((shortest && nb_av_enc > 1) || limit_frames_av_enc || nb_audio_fs) {
         int sq_idx, ret;
 
-        sq_idx = sch_add_sq_enc(mux->sch, buf_size_us, mux);
+        sq_idx = sch_add_sq_enc(mux->sch, buf_size_us, buf_size_bytes, mux);
         if (sq_idx < 0)
             return sq_idx;
 
@@ -2112,6 +2117,7 @@ static int setup_sync_queues(Muxer *mux, AVFormatContext *oc,
         mux->sq_mux = sq_alloc(SYNC_QUEUE_PACKETS, buf_size_us, mux);
         if (!mux->sq_mux)
             return AVERROR(ENOMEM);
+        sq_limit_bytes(mux->sq_mux, buf_size_bytes);
 
         mux->sq_pkt = av_packet_alloc();
         if (!mux->sq_pkt)
@@ -2132,11 +2138,17 @@ static int setup_sync_queues(Muxer *mux, AVFormatContext *oc,
 
             if (ms->max_frames != INT64_MAX)
                 sq_limit_frames(mux->sq_mux, ms->sq_idx_mux, ms->max_frames);
+
+            /* do not let sparse streams hold back the others for longer
+             * than requested */
+            if (IS_SPARSE(type) && sparse_timeout_us > 0)
+                sq_stream_timeout(mux->sq_mux, ms->sq_idx_mux, sparse_timeout_us);
         }
     }
 
 #undef IS_AV_ENC
 #undef IS_INTERLEAVED
+#undef IS_SPARSE
 
     return 0;
 }
@@ -3408,6 +3420,8 @@ int of_open(const OptionsContext *o, const char *filename, Scheduler *sch)
     }
 
     err = setup_sync_queues(mux, oc, o->shortest_buf_duration * AV_TIME_BASE,
+                            FFMAX(o->shortest_buf_size, 0),
+                            o->shortest_sparse_timeout * AV_TIME_BASE,
                             o->shortest);
     if (err < 0) {
         av_log(mux, AV_LOG_FATAL, "Error setting up output sync queues\n");
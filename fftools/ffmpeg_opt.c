@@ -51,44 +51,63 @@
 
 HWDevice *filter_hw_device;
 
-char *vstats_filename;
-
-float dts_delta_threshold   = 10;
-float dts_error_threshold   = 3600*30;
-
 #if FFMPEG_OPT_VSYNC
-enum VideoSyncMethod video_sync_method = VSYNC_AUTO;
+#define VSYNC_OPTION(X) \
+    X(, enum VideoSyncMethod, video_sync_method, VSYNC_AUTO)
+#else
+#define VSYNC_OPTION(X)
 #endif
-float frame_drop_threshold = 0;
-int do_benchmark      = 0;
-int do_benchmark_all  = 0;
-int do_hex_dump       = 0;
-int do_pkt_dump       = 0;
-int copy_ts           = 0;
-int start_at_zero     = 0;
-int copy_tb           = -1;
-int debug_ts          = 0;
-int exit_on_error     = 0;
-int abort_on_flags    = 0;
-int print_stats       = -1;
-int stdin_interaction = 1;
-float max_error_rate  = 2.0/3;
-char *filter_nbthreads;
-int filter_complex_nbthreads = 0;
-int filter_buffered_frames = 0;
-int vstats_version = 2;
-int print_graphs = 0;
-char *print_graphs_file = NULL;
-char *print_graphs_format = NULL;
-int auto_conversion_filters = 1;
-int64_t stats_period = 500000;
-
-
-static int file_overwrite     = 0;
-static int no_file_overwrite  = 0;
-int ignore_unknown_streams = 0;
-int copy_unknown_streams = 0;
-int recast_media = 0;
+
+/*
+ * The variables set by global options, with their default values. The
+ * defaults are restored by reset_global_options() between batch jobs, so
+ * every global set by an option must be listed here.
+ */
+#define GLOBAL_OPTIONS(X)                                               \
+    X(,       float,   dts_delta_threshold,      10)                    \
+    X(,       float,   dts_error_threshold,      3600*30)               \
+    VSYNC_OPTION(X)                                                     \
+    X(,       float,   frame_drop_threshold,     0)                     \
+    X(,       int,     do_benchmark,             0)                     \
+    X(,       int,     do_benchmark_all,         0)                     \
+    X(,       int,     do_hex_dump,              0)                     \
+    X(,       int,     do_pkt_dump,              0)                     \
+    X(,       int,     copy_ts,                  0)                     \
+    X(,       int,     start_at_zero,            0)                     \
+    X(,       int,     copy_tb,                  -1)                    \
+    X(,       int,     debug_ts,                 0)                     \
+    X(,       int,     exit_on_error,            0)                     \
+    X(,       int,     abort_on_flags,           0)                     \
+    X(,       int,     print_stats,              -1)                    \
+    X(,       int,     stdin_interaction,        1)                     \
+    X(,       float,   max_error_rate,           2.0/3)                 \
+    X(,       int,     filter_complex_nbthreads, 0)                     \
+    X(,       int,     filter_buffered_frames,   0)                     \
+    X(,       int64_t, filter_pool_size,         0)                     \
+    X(,       int,     vstats_version,           2)                     \
+    X(,       int,     print_graphs,             0)                     \
+    X(,       int,     auto_conversion_filters,  1)                     \
+    X(,       int64_t, stats_period,             500000)                \
+    X(,       int,     progress_sched,           0)                     \
+    X(static, int,     file_overwrite,           0)                     \
+    X(static, int,     no_file_overwrite,        0)                     \
+    X(,       int,     ignore_unknown_streams,   0)                     \
+    X(,       int,     copy_unknown_streams,     0)                     \
+    X(,       int,     recast_media,             0)
+
+/* string global options, which default to NULL */
+#define GLOBAL_STRING_OPTIONS(X)                                        \
+    X(vstats_filename)                                                  \
+    X(filter_nbthreads)                                                 \
+    X(filter_fuse)                                                      \
+    X(filter_profile)                                                   \
+    X(print_graphs_file)                                                \
+    X(print_graphs_format)
+
+#define DEFINE_OPTION(storage, type, name, def) storage type name = def;
+#define DEFINE_STRING_OPTION(name) char *name = NULL;
+GLOBAL_OPTIONS(DEFINE_OPTION)
+GLOBAL_STRING_OPTIONS(DEFINE_STRING_OPTION)
 
 // this struct is passed as the optctx argument
 // to func_arg() for global options
@@ -628,6 +647,34 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(go->sch, arg);
 }
 
+static int opt_thread_budget(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    double num;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT, 0, INT_MAX, &num);
+    if (ret < 0)
+        return ret;
+
+    sch_set_thread_budget(go->sch, num);
+    return 0;
+}
+
+static int opt_thread_queue_memory(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    double num;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT64, 0, SIZE_MAX, &num);
+    if (ret < 0)
+        return ret;
+
+    sch_set_queue_memory(go->sch, num);
+    return 0;
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1378,6 +1425,16 @@ static int open_files(OptionGroupList *l, const char *inout, Scheduler *sch,
     return 0;
 }
 
+void reset_global_options(void)
+{
+#define RESET_OPTION(storage, type, name, def) name = def;
+#define RESET_STRING_OPTION(name) av_freep(&name);
+    GLOBAL_OPTIONS(RESET_OPTION)
+    GLOBAL_STRING_OPTIONS(RESET_STRING_OPTION)
+#undef RESET_OPTION
+#undef RESET_STRING_OPTION
+}
+
 int ffmpeg_parse_options(int argc, char **argv, Scheduler *sch)
 {
     GlobalOptionsContext go = { .sch = sch };
@@ -1477,6 +1534,13 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_batch(void *optctx, const char *opt, const char *arg)
+{
+    // the batch manifest itself is handled in main()
+    av_log(NULL, AV_LOG_ERROR, "Option -%s cannot be used in a batch job\n", opt);
+    return AVERROR(EINVAL);
+}
+
 int opt_timelimit(void *optctx, const char *opt, const char *arg)
 {
 #if HAVE_SETRLIMIT
@@ -1623,6 +1687,12 @@ const OptionDef options[] = {
     { "progress",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
+    { "progress_sched",         OPT_TYPE_BOOL, OPT_EXPERT,
+        { &progress_sched },
+      "add per-thread scheduler statistics to the -progress output" },
+    { "batch",                  OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_batch },
+      "run one transcoding job for every line of the manifest", "manifest" },
     { "stdin",                  OPT_TYPE_BOOL, OPT_EXPERT,
         { &stdin_interaction },
       "enable or disable interaction on standard input" },
@@ -1669,6 +1739,12 @@ const OptionDef options[] = {
     { "shortest_buf_duration",  OPT_TYPE_FLOAT, OPT_EXPERT | OPT_OFFSET | OPT_OUTPUT,
         { .off = OFFSET(shortest_buf_duration) },
         "maximum buffering duration (in seconds) for the -shortest option" },
+    { "shortest_buf_size",      OPT_TYPE_INT64, OPT_EXPERT | OPT_OFFSET | OPT_OUTPUT,
+        { .off = OFFSET(shortest_buf_size) },
+        "maximum buffering size (in bytes) for the -shortest option", "size" },
+    { "shortest_sparse_timeout", OPT_TYPE_FLOAT, OPT_EXPERT | OPT_OFFSET | OPT_OUTPUT,
+        { .off = OFFSET(shortest_sparse_timeout) },
+        "maximum time (in seconds) subtitle and data streams may hold back the other streams for the -shortest option", "seconds" },
     { "bitexact",               OPT_TYPE_BOOL, OPT_EXPERT | OPT_OFFSET | OPT_OUTPUT | OPT_INPUT,
         { .off = OFFSET(bitexact) },
         "bitexact mode" },
@@ -1713,12 +1789,24 @@ const OptionDef options[] = {
         { .off = OFFSET(filters) },
         "apply specified filters to audio/video", "filter_graph",
         .u1.names_alt = alt_filter, },
+    { "filter_stages",          OPT_TYPE_INT, OPT_PERSTREAM | OPT_OUTPUT | OPT_EXPERT,
+        { .off = OFFSET(filter_stages) },
+        "split the filtergraph into this many pipelined stages", "nb_stages" },
     { "filter_threads",         OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_threads },
         "number of non-complex filter threads" },
     { "filter_buffered_frames", OPT_TYPE_INT, OPT_EXPERT,
         { &filter_buffered_frames },
         "maximum number of buffered frames in a filter graph" },
+    { "filter_pool_size",       OPT_TYPE_INT64, OPT_EXPERT,
+        { &filter_pool_size },
+        "maximum size in bytes of the video frame buffers of a filter graph", "size" },
+    { "filter_fuse",            OPT_TYPE_STRING, OPT_EXPERT,
+        { &filter_fuse },
+        "set which chains of filters are fused", "flags" },
+    { "filter_profile",         OPT_TYPE_STRING, OPT_EXPERT,
+        { &filter_profile },
+        "print the time spent in each filter, as text or json", "format" },
 #if FFMPEG_OPT_FILTER_SCRIPT
     { "filter_script",          OPT_TYPE_STRING, OPT_PERSTREAM | OPT_EXPERT | OPT_OUTPUT,
         { .off = OFFSET(filter_scripts) },
@@ -1730,12 +1818,21 @@ const OptionDef options[] = {
     { "drop_changed",          OPT_TYPE_INT, OPT_PERSTREAM | OPT_INPUT | OPT_EXPERT,
         { .off = OFFSET(drop_changed) },
         "drop frame instead of reiniting filtergraph on input parameter changes", "" },
+    { "scale_changed",         OPT_TYPE_INT, OPT_PERSTREAM | OPT_INPUT | OPT_EXPERT,
+        { .off = OFFSET(scale_changed) },
+        "scale video frames to the configured parameters instead of reiniting filtergraph on input parameter changes", "" },
     { "filter_complex",         OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", OPT_TYPE_INT, OPT_EXPERT,
         { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "thread_budget",          OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_thread_budget },
+        "limit the total number of threads used for transcoding", "nb_threads" },
+    { "thread_queue_memory",    OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_thread_queue_memory },
+        "limit the memory used by data queued between threads", "bytes" },
     { "lavfi",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
@@ -32,6 +32,7 @@
 #include "libavcodec/packet.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
@@ -44,6 +45,10 @@
 // FIXME: some other value? make this dynamic?
 #define SCHEDULE_TOLERANCE (100 * 1000)
 
+// packet queues of default size may grow up to this many packets to absorb
+// bursts, see tq_set_max_size()
+#define MAX_PACKET_THREAD_QUEUE_SIZE (16 * DEFAULT_PACKET_THREAD_QUEUE_SIZE)
+
 enum QueueType {
     QUEUE_PACKETS,
     QUEUE_FRAMES,
@@ -54,6 +59,9 @@ typedef struct SchWaiter {
     pthread_cond_t      cond;
     atomic_int          choked;
 
+    // total time spent in waiter_wait(), in microseconds
+    atomic_int_least64_t wait_time;
+
     // the following are internal state of schedule_update_locked() and must not
     // be accessed outside of it
     int                 choked_prev;
@@ -69,6 +77,10 @@ typedef struct SchTask {
 
     pthread_t           thread;
     int                 thread_running;
+
+    // wallclock times the task started and finished running, for statistics
+    int64_t             start_time;
+    atomic_int_least64_t end_time;
 } SchTask;
 
 typedef struct SchDecOutput {
@@ -305,6 +317,10 @@ struct Scheduler {
     char               *sdp_filename;
     int                 sdp_auto;
 
+    unsigned            thread_budget;
+    size_t              queue_memory;
+    int                 stats;
+
     enum SchedulerState state;
     atomic_int          terminate;
 
@@ -321,11 +337,14 @@ struct Scheduler {
  */
 static int waiter_wait(Scheduler *sch, SchWaiter *w)
 {
+    int64_t wait_start;
     int terminate;
 
     if (!atomic_load(&w->choked))
         return 0;
 
+    wait_start = av_gettime_relative();
+
     pthread_mutex_lock(&w->lock);
 
     while (atomic_load(&w->choked) && !atomic_load(&sch->terminate))
@@ -335,6 +354,8 @@ static int waiter_wait(Scheduler *sch, SchWaiter *w)
 
     pthread_mutex_unlock(&w->lock);
 
+    atomic_fetch_add(&w->wait_time, av_gettime_relative() - wait_start);
+
     return terminate;
 }
 
@@ -353,6 +374,7 @@ static int waiter_init(SchWaiter *w)
     int ret;
 
     atomic_init(&w->choked, 0);
+    atomic_init(&w->wait_time, 0);
 
     ret = pthread_mutex_init(&w->lock, NULL);
     if (ret)
@@ -375,12 +397,15 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
                        enum QueueType type)
 {
     ThreadQueue *tq;
+    int adaptive = 0;
 
     if (queue_size <= 0) {
         if (type == QUEUE_FRAMES)
             queue_size = DEFAULT_FRAME_THREAD_QUEUE_SIZE;
-        else
+        else {
             queue_size = DEFAULT_PACKET_THREAD_QUEUE_SIZE;
+            adaptive   = 1;
+        }
     }
 
     if (type == QUEUE_FRAMES) {
@@ -397,6 +422,15 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
     if (!tq)
         return AVERROR(ENOMEM);
 
+    // only let the queue grow when the user did not request a specific size
+    if (adaptive) {
+        int ret = tq_set_max_size(tq, MAX_PACKET_THREAD_QUEUE_SIZE);
+        if (ret < 0) {
+            tq_free(&tq);
+            return ret;
+        }
+    }
+
     *ptq = tq;
     return 0;
 }
@@ -411,6 +445,9 @@ static int task_start(SchTask *task)
 
     av_assert0(!task->thread_running);
 
+    task->start_time = av_gettime_relative();
+    atomic_init(&task->end_time, 0);
+
     ret = pthread_create(&task->thread, NULL, task_wrapper, task);
     if (ret) {
         av_log(task->func_arg, AV_LOG_ERROR, "pthread_create() failed: %s\n",
@@ -615,6 +652,71 @@ int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
     return sch->sdp_filename ? 0 : AVERROR(ENOMEM);
 }
 
+void sch_set_thread_budget(Scheduler *sch, unsigned nb_threads)
+{
+    sch->thread_budget = nb_threads;
+}
+
+void sch_set_queue_memory(Scheduler *sch, size_t max_bytes)
+{
+    sch->queue_memory = max_bytes;
+}
+
+void sch_enable_stats(Scheduler *sch)
+{
+    sch->stats = 1;
+}
+
+static void queue_stats_apply(Scheduler *sch)
+{
+    if (!sch->stats)
+        return;
+
+    for (unsigned i = 0; i < sch->nb_dec; i++)
+        tq_enable_stats(sch->dec[i].queue);
+    for (unsigned i = 0; i < sch->nb_enc; i++)
+        tq_enable_stats(sch->enc[i].queue);
+    for (unsigned i = 0; i < sch->nb_filters; i++)
+        tq_enable_stats(sch->filters[i].queue);
+    for (unsigned i = 0; i < sch->nb_mux; i++)
+        tq_enable_stats(sch->mux[i].queue);
+}
+
+static void queue_memory_apply(Scheduler *sch)
+{
+    unsigned nb_queues = sch->nb_dec + sch->nb_enc + sch->nb_filters + sch->nb_mux;
+    size_t max_bytes;
+
+    if (!sch->queue_memory || !nb_queues)
+        return;
+
+    max_bytes = FFMAX(sch->queue_memory / nb_queues, 1);
+
+    for (unsigned i = 0; i < sch->nb_dec; i++)
+        tq_set_max_bytes(sch->dec[i].queue, max_bytes);
+    for (unsigned i = 0; i < sch->nb_enc; i++)
+        tq_set_max_bytes(sch->enc[i].queue, max_bytes);
+    for (unsigned i = 0; i < sch->nb_filters; i++)
+        tq_set_max_bytes(sch->filters[i].queue, max_bytes);
+    for (unsigned i = 0; i < sch->nb_mux; i++)
+        tq_set_max_bytes(sch->mux[i].queue, max_bytes);
+}
+
+int sch_thread_share(const Scheduler *sch)
+{
+    unsigned nb_workers = sch->nb_dec + sch->nb_enc + sch->nb_filters;
+    unsigned nb_tasks   = sch->nb_demux + sch->nb_mux + nb_workers;
+
+    if (!sch->thread_budget)
+        return 0;
+
+    // with a single thread, the work is done on the task thread itself
+    if (!nb_workers || sch->thread_budget <= nb_tasks)
+        return 1;
+
+    return FFMAX((sch->thread_budget - nb_tasks) / nb_workers, 1);
+}
+
 static const AVClass sch_mux_class = {
     .class_name                = "SchMux",
     .version                   = LIBAVUTIL_VERSION_INT,
@@ -860,7 +962,8 @@ int sch_add_filtergraph(Scheduler *sch, unsigned nb_inputs, unsigned nb_outputs,
     return idx;
 }
 
-int sch_add_sq_enc(Scheduler *sch, uint64_t buf_size_us, void *logctx)
+int sch_add_sq_enc(Scheduler *sch, uint64_t buf_size_us, size_t buf_size_bytes,
+                   void *logctx)
 {
     SchSyncQueue *sq;
     int ret;
@@ -873,6 +976,7 @@ int sch_add_sq_enc(Scheduler *sch, uint64_t buf_size_us, void *logctx)
     sq->sq = sq_alloc(SYNC_QUEUE_FRAMES, buf_size_us, logctx);
     if (!sq->sq)
         return AVERROR(ENOMEM);
+    sq_limit_bytes(sq->sq, buf_size_bytes);
 
     sq->frame = av_frame_alloc();
     if (!sq->frame)
@@ -1443,6 +1547,53 @@ fail:
     return ret;
 }
 
+/**
+ * Let the queues that are only ever sent to from a single thread avoid
+ * locking.
+ */
+static int queues_set_single_producer(Scheduler *sch)
+{
+    int ret;
+
+    for (unsigned i = 0; i < sch->nb_dec; i++) {
+        SchDec *dec = &sch->dec[i];
+        int heartbeat = 0;
+
+        // subtitle heartbeats are sent from the muxer thread
+        for (unsigned j = 0; j < sch->nb_mux && !heartbeat; j++) {
+            const SchMux *mux = &sch->mux[j];
+
+            for (unsigned k = 0; k < mux->nb_streams; k++) {
+                const SchMuxStream *ms = &mux->streams[k];
+
+                for (unsigned l = 0; l < ms->nb_sub_heartbeat_dst; l++)
+                    heartbeat |= ms->sub_heartbeat_dst[l] == i;
+            }
+        }
+        if (heartbeat)
+            continue;
+
+        ret = tq_set_single_producer(dec->queue);
+        if (ret < 0)
+            return ret;
+    }
+
+    for (unsigned i = 0; i < sch->nb_enc; i++) {
+        SchEnc *enc = &sch->enc[i];
+
+        // encoders in a sync queue receive frames from whichever thread
+        // feeds the sync queue
+        if (enc->sq_idx[0] >= 0)
+            continue;
+
+        ret = tq_set_single_producer(enc->queue);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 static int start_prepare(Scheduler *sch)
 {
     int ret;
@@ -1585,6 +1736,13 @@ static int start_prepare(Scheduler *sch)
     if (ret < 0)
         return ret;
 
+    ret = queues_set_single_producer(sch);
+    if (ret < 0)
+        return ret;
+
+    queue_memory_apply(sch);
+    queue_stats_apply(sch);
+
     return 0;
 }
 
@@ -2553,6 +2711,8 @@ static void *task_wrapper(void *arg)
            "Terminating thread with return code %d (%s)\n", ret,
            ret < 0 ? av_err2str(ret) : "success");
 
+    atomic_store(&task->end_time, av_gettime_relative());
+
     return (void*)(intptr_t)ret;
 }
 
@@ -2629,3 +2789,112 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts)
 
     return ret;
 }
+
+static int64_t dst_send_wait(const Scheduler *sch, SchedulerNode dst)
+{
+    switch (dst.type) {
+    case SCH_NODE_TYPE_DEC:
+        return tq_send_wait(sch->dec[dst.idx].queue, 0);
+    case SCH_NODE_TYPE_ENC:
+        return tq_send_wait(sch->enc[dst.idx].queue, 0);
+    case SCH_NODE_TYPE_FILTER_IN:
+        return tq_send_wait(sch->filters[dst.idx].queue, dst.idx_stream);
+    case SCH_NODE_TYPE_MUX:
+        // the muxer queue only exists once the scheduler was started
+        return sch->mux[dst.idx].queue ?
+               tq_send_wait(sch->mux[dst.idx].queue, dst.idx_stream) : 0;
+    default: av_assert0(0);
+    }
+}
+
+static void print_task_stats(AVBPrint *bp, const char *name, unsigned idx,
+                             const SchTask *task, ThreadQueue *queue,
+                             int64_t choked, int64_t wait_out)
+{
+    int64_t end_time = atomic_load(&task->end_time);
+    int64_t busy, wait_in = 0;
+
+    if (!task->start_time)
+        return;
+
+    if (!end_time)
+        end_time = av_gettime_relative();
+
+    if (queue) {
+        ThreadQueueStats st;
+
+        tq_stats(queue, &st);
+        wait_in = st.recv_wait;
+
+        av_bprintf(bp, "sched_%s%u_queue=%zu\n",      name, idx, st.nb_queued);
+        av_bprintf(bp, "sched_%s%u_queue_max=%zu\n",  name, idx, st.max_queued);
+        av_bprintf(bp, "sched_%s%u_queue_size=%zu\n", name, idx, st.queue_size);
+        av_bprintf(bp, "sched_%s%u_queue_bytes=%zu\n", name, idx, st.queued_bytes);
+        av_bprintf(bp, "sched_%s%u_received=%"PRIu64"\n", name, idx, st.nb_received);
+        av_bprintf(bp, "sched_%s%u_latency_hist=", name, idx);
+        for (int i = 0; i < TQ_LATENCY_BUCKETS; i++)
+            av_bprintf(bp, "%s%"PRIu64, i ? "," : "", st.latency[i]);
+        av_bprintf(bp, "\n");
+    }
+
+    busy = FFMAX(end_time - task->start_time - wait_in - wait_out - choked, 0);
+
+    av_bprintf(bp, "sched_%s%u_busy_us=%"PRId64"\n",     name, idx, busy);
+    av_bprintf(bp, "sched_%s%u_wait_in_us=%"PRId64"\n",  name, idx, wait_in);
+    av_bprintf(bp, "sched_%s%u_wait_out_us=%"PRId64"\n", name, idx, wait_out);
+    av_bprintf(bp, "sched_%s%u_choked_us=%"PRId64"\n",   name, idx, choked);
+}
+
+void sch_print_stats(Scheduler *sch, AVBPrint *bp)
+{
+    for (unsigned i = 0; i < sch->nb_demux; i++) {
+        SchDemux *d = &sch->demux[i];
+        int64_t wait_out = 0;
+
+        for (unsigned j = 0; j < d->nb_streams; j++)
+            for (unsigned k = 0; k < d->streams[j].nb_dst; k++)
+                wait_out += dst_send_wait(sch, d->streams[j].dst[k]);
+
+        print_task_stats(bp, "demux", i, &d->task, NULL,
+                         atomic_load(&d->waiter.wait_time), wait_out);
+    }
+
+    for (unsigned i = 0; i < sch->nb_dec; i++) {
+        SchDec *dec = &sch->dec[i];
+        int64_t wait_out = 0;
+
+        for (unsigned j = 0; j < dec->nb_outputs; j++)
+            for (unsigned k = 0; k < dec->outputs[j].nb_dst; k++)
+                wait_out += dst_send_wait(sch, dec->outputs[j].dst[k]);
+
+        print_task_stats(bp, "dec", i, &dec->task, dec->queue, 0, wait_out);
+    }
+
+    for (unsigned i = 0; i < sch->nb_filters; i++) {
+        SchFilterGraph *fg = &sch->filters[i];
+        int64_t wait_out = 0;
+
+        for (unsigned j = 0; j < fg->nb_outputs; j++)
+            if (fg->outputs[j].dst.type)
+                wait_out += dst_send_wait(sch, fg->outputs[j].dst);
+
+        print_task_stats(bp, "filter", i, &fg->task, fg->queue,
+                         atomic_load(&fg->waiter.wait_time), wait_out);
+    }
+
+    for (unsigned i = 0; i < sch->nb_enc; i++) {
+        SchEnc *enc = &sch->enc[i];
+        int64_t wait_out = 0;
+
+        for (unsigned j = 0; j < enc->nb_dst; j++)
+            wait_out += dst_send_wait(sch, enc->dst[j]);
+
+        print_task_stats(bp, "enc", i, &enc->task, enc->queue, 0, wait_out);
+    }
+
+    for (unsigned i = 0; i < sch->nb_mux; i++) {
+        SchMux *mux = &sch->mux[i];
+
+        print_task_stats(bp, "mux", i, &mux->task, mux->queue, 0, 0);
+    }
+}
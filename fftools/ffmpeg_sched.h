@@ -251,6 +251,7 @@ int sch_add_mux(Scheduler *sch, SchThreadFunc func, int (*init)(void *),
 /**
  * Default size of a packet thread queue.  For muxing this can be overridden by
  * the thread_queue_size option as passed to a call to sch_add_mux().
+ * Queues of default size grow when their producer and consumer run in bursts.
  */
 #define DEFAULT_PACKET_THREAD_QUEUE_SIZE 8
 
@@ -298,6 +299,67 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
  */
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename);
 
+/**
+ * Limit the total number of threads used for transcoding.
+ *
+ * The budget covers both the threads running the scheduler tasks and the
+ * worker threads created by decoders, encoders and filtergraphs. It is
+ * enforced by sharing it among the components whose thread count was not set
+ * explicitly, see sch_thread_share().
+ *
+ * @param nb_threads maximum number of threads, 0 means no limit
+ */
+void sch_set_thread_budget(Scheduler *sch, unsigned nb_threads);
+
+/**
+ * Get the number of worker threads a decoder, encoder or filtergraph without
+ * an explicitly configured thread count should use.
+ *
+ * The thread budget that remains after accounting for the scheduler tasks is
+ * split evenly among all decoders, encoders and filtergraphs added to the
+ * scheduler so far. This should be called right before the component is
+ * initialized, so that as much of the transcoding graph as possible is known.
+ *
+ * @return number of threads to use, at least 1; 0 if no budget was set and
+ *         the component should choose its thread count automatically
+ */
+int sch_thread_share(const Scheduler *sch);
+
+/**
+ * Limit the total amount of memory used by the data buffered in the queues
+ * between the scheduler tasks. The limit is divided evenly among the queues;
+ * a queue exceeding its share blocks further sending until it is drained,
+ * but always accepts at least one item.
+ *
+ * Must be called before sch_start().
+ *
+ * @param max_bytes maximum size in bytes, 0 means no limit
+ */
+void sch_set_queue_memory(Scheduler *sch, size_t max_bytes);
+
+/**
+ * Collect the queue statistics printed by sch_print_stats(). Without it, the
+ * queue occupancy, latency and wait times are reported as 0.
+ *
+ * Must be called before sch_start().
+ */
+void sch_enable_stats(Scheduler *sch);
+
+struct AVBPrint;
+
+/**
+ * Print per-task statistics as key=value lines, in the format used for
+ * -progress output. May be called at any time after sch_start().
+ *
+ * For every task, the time it spent running, waiting for input, waiting for
+ * free space in the queues of its destinations and being held back by the
+ * scheduler is reported; busy time includes any blocking inside the task
+ * itself, such as demuxer I/O. For tasks with an input queue, its current and
+ * peak occupancy and a histogram of the time the items spent in it are
+ * printed as well, see ThreadQueueStats.
+ */
+void sch_print_stats(Scheduler *sch, struct AVBPrint *bp);
+
 /**
  * Add an encoder to the scheduler.
  *
@@ -319,12 +381,14 @@ int sch_add_enc(Scheduler *sch, SchThreadFunc func, void *ctx,
  * Add an pre-encoding sync queue to the scheduler.
  *
  * @param buf_size_us Sync queue buffering size, passed to sq_alloc().
+ * @param buf_size_bytes Sync queue memory limit, passed to sq_limit_bytes().
  * @param logctx Logging context for the sync queue. passed to sq_alloc().
  *
  * @retval ">=0" Index of the newly-created sync queue.
  * @retval "<0"  Error code.
  */
-int sch_add_sq_enc(Scheduler *sch, uint64_t buf_size_us, void *logctx);
+int sch_add_sq_enc(Scheduler *sch, uint64_t buf_size_us, size_t buf_size_bytes,
+                   void *logctx);
 int sch_sq_add_enc(Scheduler *sch, unsigned sq_idx, unsigned enc_idx,
                    int limiting, uint64_t max_frames);
 
@@ -85,6 +85,10 @@ typedef struct SyncQueueStream {
     uint64_t         samples_sent;
     uint64_t         frames_max;
     int              frame_samples;
+
+    /* maximum time in microseconds this stream may lag behind the stream
+     * furthest ahead before it is assumed to have advanced, 0 for none */
+    int64_t          timeout_us;
 } SyncQueueStream;
 
 struct SyncQueue {
@@ -102,6 +106,9 @@ struct SyncQueue {
 
     // maximum buffering duration in microseconds
     int64_t buf_size_us;
+    // maximum size of buffered data in bytes, 0 for no limit
+    size_t  buf_size_bytes;
+    size_t  queued_bytes;
 
     SyncQueueStream *streams;
     unsigned int  nb_streams;
@@ -133,6 +140,31 @@ static int frame_samples(const SyncQueue *sq, SyncQueueFrame frame)
     return (sq->type == SYNC_QUEUE_PACKETS) ? 0 : frame.f->nb_samples;
 }
 
+static size_t samples_size(const AVFrame *frame, int nb_samples)
+{
+    int size = av_samples_get_buffer_size(NULL, frame->ch_layout.nb_channels,
+                                          nb_samples, frame->format, 1);
+    return FFMAX(size, 0);
+}
+
+/* size of the data referenced by a frame, as accounted in queued_bytes */
+static size_t frame_size(const SyncQueue *sq, SyncQueueFrame frame)
+{
+    size_t size = 0;
+
+    if (sq->type == SYNC_QUEUE_PACKETS)
+        return frame.p->size;
+
+    // audio frames may be partially consumed, so count the samples only
+    if (frame.f->nb_samples)
+        return samples_size(frame.f, frame.f->nb_samples);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(frame.f->buf) && frame.f->buf[i]; i++)
+        size += frame.f->buf[i]->size;
+
+    return size;
+}
+
 static int frame_null(const SyncQueue *sq, SyncQueueFrame frame)
 {
     return (sq->type == SYNC_QUEUE_PACKETS) ? (frame.p == NULL) : (frame.f == NULL);
@@ -301,9 +333,11 @@ static int overflow_heartbeat(SyncQueue *sq, int stream_idx)
                        av_container_fifo_peek(st->fifo, (void**)&frame, i) >= 0; i++)
         tail_ts = frame_end(sq, frame, 0);
 
-    /* overflow triggers when the tail is over specified duration behind the head */
+    /* overflow triggers when the tail is over specified duration behind the
+     * head, or when too much data is buffered */
     if (tail_ts == AV_NOPTS_VALUE || tail_ts >= st->head_ts ||
-        av_rescale_q(st->head_ts - tail_ts, st->tb, AV_TIME_BASE_Q) < sq->buf_size_us)
+        (av_rescale_q(st->head_ts - tail_ts, st->tb, AV_TIME_BASE_Q) < sq->buf_size_us &&
+         (!sq->buf_size_bytes || sq->queued_bytes <= sq->buf_size_bytes)))
         return 0;
 
     /* signal a fake timestamp for all streams that prevent tail_ts from being output */
@@ -330,8 +364,51 @@ static int overflow_heartbeat(SyncQueue *sq, int stream_idx)
     return 1;
 }
 
+/* Signal a fake timestamp for all streams with a timeout that lag more than
+ * that timeout behind the stream that is furthest ahead.
+ *
+ * @return 1 if heartbeat triggered, 0 otherwise
+ */
+static int timeout_heartbeat(SyncQueue *sq)
+{
+    const SyncQueueStream *st_max = NULL;
+    int ret = 0;
+
+    for (unsigned int i = 0; i < sq->nb_streams; i++) {
+        const SyncQueueStream *st = &sq->streams[i];
+        if (st->head_ts != AV_NOPTS_VALUE &&
+            (!st_max || av_compare_ts(st->head_ts, st->tb,
+                                      st_max->head_ts, st_max->tb) > 0))
+            st_max = st;
+    }
+    if (!st_max)
+        return 0;
+
+    for (unsigned int i = 0; i < sq->nb_streams; i++) {
+        SyncQueueStream *st = &sq->streams[i];
+        int64_t ts;
+
+        if (!st->timeout_us || st->finished)
+            continue;
+
+        ts = av_rescale_q(st_max->head_ts, st_max->tb, st->tb) -
+             av_rescale_q(st->timeout_us, AV_TIME_BASE_Q, st->tb);
+        if (st->head_ts != AV_NOPTS_VALUE && st->head_ts >= ts)
+            continue;
+
+        av_log(sq->logctx, AV_LOG_DEBUG, "sq: %u timeout heartbeat %s -> %s\n",
+               i, av_ts2timestr(st->head_ts, &st->tb), av_ts2timestr(ts, &st->tb));
+
+        stream_update_ts(sq, i, ts);
+        ret = 1;
+    }
+
+    return ret;
+}
+
 int sq_send(SyncQueue *sq, unsigned int stream_idx, SyncQueueFrame frame)
 {
+    size_t size;
     SyncQueueStream *st;
     int64_t ts;
     int ret, nb_samples;
@@ -357,7 +434,8 @@ int sq_send(SyncQueue *sq, unsigned int stream_idx, SyncQueueFrame frame)
                                          frame.f->time_base);
     }
 
-    ts = frame_end(sq, frame, 0);
+    ts   = frame_end(sq, frame, 0);
+    size = frame_size(sq, frame);
 
     av_log(sq->logctx, AV_LOG_DEBUG, "sq: send %u ts %s\n", stream_idx,
            av_ts2timestr(ts, &st->tb));
@@ -366,6 +444,8 @@ int sq_send(SyncQueue *sq, unsigned int stream_idx, SyncQueueFrame frame)
     if (ret < 0)
         return ret;
 
+    sq->queued_bytes += size;
+
     stream_update_ts(sq, stream_idx, ts);
 
     st->samples_queued += nb_samples;
@@ -446,6 +526,7 @@ static int receive_samples(SyncQueue *sq, SyncQueueStream *st,
         dst->nb_samples = nb_samples;
         offset_audio(src.f, nb_samples);
         st->samples_queued -= nb_samples;
+        sq->queued_bytes   -= samples_size(dst, nb_samples);
 
         goto finish;
     }
@@ -484,6 +565,7 @@ static int receive_samples(SyncQueue *sq, SyncQueueStream *st,
             av_container_fifo_drain(st->fifo, 1);
 
         st->samples_queued -= to_copy;
+        sq->queued_bytes   -= samples_size(dst, to_copy);
 
         dst->nb_samples += to_copy;
     }
@@ -543,6 +625,7 @@ static int receive_for_stream(SyncQueue *sq, unsigned int stream_idx,
 
                 av_assert0(st->samples_queued >= frame_samples(sq, frame));
                 st->samples_queued -= frame_samples(sq, frame);
+                sq->queued_bytes   -= frame_size(sq, frame);
             }
 
             av_log(sq->logctx, AV_LOG_DEBUG,
@@ -587,8 +670,10 @@ int sq_receive(SyncQueue *sq, int stream_idx, SyncQueueFrame frame)
 {
     int ret = receive_internal(sq, stream_idx, frame);
 
-    /* try again if the queue overflowed and triggered a fake heartbeat
-     * for lagging streams */
+    /* try again if some streams timed out, or the queue overflowed, and
+     * triggered a fake heartbeat for lagging streams */
+    if (ret == AVERROR(EAGAIN) && timeout_heartbeat(sq))
+        ret = receive_internal(sq, stream_idx, frame);
     if (ret == AVERROR(EAGAIN) && overflow_heartbeat(sq, stream_idx))
         ret = receive_internal(sq, stream_idx, frame);
 
@@ -637,6 +722,17 @@ void sq_limit_frames(SyncQueue *sq, unsigned int stream_idx, uint64_t frames)
         finish_stream(sq, stream_idx);
 }
 
+void sq_stream_timeout(SyncQueue *sq, unsigned int stream_idx, int64_t timeout_us)
+{
+    av_assert0(stream_idx < sq->nb_streams);
+    sq->streams[stream_idx].timeout_us = timeout_us;
+}
+
+void sq_limit_bytes(SyncQueue *sq, size_t max_bytes)
+{
+    sq->buf_size_bytes = max_bytes;
+}
+
 void sq_frame_samples(SyncQueue *sq, unsigned int stream_idx,
                       int frame_samples)
 {
@@ -71,6 +71,27 @@ int sq_add_stream(SyncQueue *sq, int limiting);
 void sq_limit_frames(SyncQueue *sq, unsigned int stream_idx,
                      uint64_t max_frames);
 
+/**
+ * Let the stream with index stream_idx lag at most timeout_us microseconds
+ * behind the stream that is furthest ahead. When it falls further behind, it
+ * is assumed to have advanced as if it had received a frame, so that the
+ * other streams are not held back by it. This is intended for sparse streams,
+ * e.g. subtitles.
+ *
+ * A timeout_us of 0 disables the timeout, which is the default.
+ */
+void sq_stream_timeout(SyncQueue *sq, unsigned int stream_idx,
+                       int64_t timeout_us);
+
+/**
+ * Limit the total size of the data buffered in the queue to max_bytes. When
+ * it is exceeded, lagging streams are treated in the same way as when the
+ * buffered duration exceeds buf_size_us.
+ *
+ * A max_bytes of 0 disables the limit, which is the default.
+ */
+void sq_limit_bytes(SyncQueue *sq, size_t max_bytes);
+
 /**
  * Set a constant output audio frame size, in samples. Can only be used with
  * SYNC_QUEUE_FRAMES queues and audio streams.
@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -25,8 +26,10 @@
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
 #include "libavutil/intreadwrite.h"
+#include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #include "libavcodec/packet.h"
 
@@ -37,8 +40,21 @@ enum {
     FINISHED_RECV = (1 << 1),
 };
 
+enum {
+    SLEEPING_SEND = (1 << 0),
+    SLEEPING_RECV = (1 << 1),
+};
+
+typedef struct ThreadQueueEntry {
+    unsigned int    stream_idx;
+    // size of the item's data, for enforcing max_bytes
+    size_t          size;
+    // time the item was sent, for latency statistics
+    int64_t         send_time;
+} ThreadQueueEntry;
+
 struct ThreadQueue {
-    int              *finished;
+    atomic_int       *finished;
     unsigned int    nb_streams;
 
     enum ThreadQueueType type;
@@ -46,8 +62,45 @@ struct ThreadQueue {
     AVContainerFifo *fifo;
     AVFifo          *fifo_stream_index;
 
+    /* Lock-free ring used instead of the FIFOs above when there is a single
+     * producer, see tq_set_single_producer(). Only the producer writes
+     * ring_tail and only the consumer writes ring_head; the lock is only
+     * taken for sleeping, which is announced in sleeping. */
+    int               spsc;
+    void            **ring;
+    ThreadQueueEntry *ring_entry;
+    size_t            ring_size;
+    atomic_size_t     ring_head;
+    atomic_size_t     ring_tail;
+    atomic_int        sleeping;
+
+    // current limit on the number of queued items, between min_size and
+    // max_size
+    atomic_size_t   queue_size;
+    size_t          min_size;
+    size_t          max_size;
+
+    size_t          max_bytes;
+    atomic_size_t   queued_bytes;
+
+    // state for adapting queue_size
+    // the consumer waited for input since the last time the queue grew
+    atomic_int      recv_starved;
+    // items received and the peak occupancy since the last shrink check,
+    // only accessed by the consumer
+    size_t          window_received;
+    size_t          window_max_queued;
+
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+
+    // statistics, only collected if stats is set
+    int                   stats;
+    atomic_int_least64_t *send_wait;
+    atomic_int_least64_t  recv_wait;
+    atomic_size_t         max_queued;
+    atomic_uint_least64_t nb_received;
+    atomic_uint_least64_t latency[TQ_LATENCY_BUCKETS];
 };
 
 void tq_free(ThreadQueue **ptq)
@@ -60,7 +113,17 @@ void tq_free(ThreadQueue **ptq)
     av_container_fifo_free(&tq->fifo);
     av_fifo_freep2(&tq->fifo_stream_index);
 
+    for (size_t i = 0; tq->ring && i < tq->ring_size; i++) {
+        if (tq->type == THREAD_QUEUE_FRAMES)
+            av_frame_free((AVFrame**)&tq->ring[i]);
+        else
+            av_packet_free((AVPacket**)&tq->ring[i]);
+    }
+    av_freep(&tq->ring);
+    av_freep(&tq->ring_entry);
+
     av_freep(&tq->finished);
+    av_freep(&tq->send_wait);
 
     pthread_cond_destroy(&tq->cond);
     pthread_mutex_destroy(&tq->lock);
@@ -96,6 +159,15 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
         goto fail;
     tq->nb_streams = nb_streams;
 
+    tq->send_wait = av_calloc(nb_streams, sizeof(*tq->send_wait));
+    if (!tq->send_wait)
+        goto fail;
+
+    for (unsigned int i = 0; i < nb_streams; i++) {
+        atomic_init(&tq->finished[i],  0);
+        atomic_init(&tq->send_wait[i], 0);
+    }
+
     tq->type = type;
 
     tq->fifo = (type == THREAD_QUEUE_FRAMES) ?
@@ -103,39 +175,340 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
     if (!tq->fifo)
         goto fail;
 
-    tq->fifo_stream_index = av_fifo_alloc2(queue_size, sizeof(unsigned), 0);
+    tq->fifo_stream_index = av_fifo_alloc2(queue_size, sizeof(ThreadQueueEntry), 0);
     if (!tq->fifo_stream_index)
         goto fail;
 
+    tq->min_size = queue_size;
+    tq->max_size = queue_size;
+
+    atomic_init(&tq->ring_head,    0);
+    atomic_init(&tq->ring_tail,    0);
+    atomic_init(&tq->sleeping,     0);
+    atomic_init(&tq->queue_size,   queue_size);
+    atomic_init(&tq->queued_bytes, 0);
+    atomic_init(&tq->recv_starved, 0);
+    atomic_init(&tq->recv_wait,    0);
+    atomic_init(&tq->max_queued,   0);
+    atomic_init(&tq->nb_received,  0);
+    for (int i = 0; i < TQ_LATENCY_BUCKETS; i++)
+        atomic_init(&tq->latency[i], 0);
+
     return tq;
 fail:
     tq_free(&tq);
     return NULL;
 }
 
+int tq_set_max_size(ThreadQueue *tq, size_t max_size)
+{
+    int ret = 0;
+
+    // the ring is allocated for the maximum size
+    av_assert0(!tq->spsc);
+
+    pthread_mutex_lock(&tq->lock);
+
+    if (max_size > tq->max_size) {
+        ret = av_fifo_grow2(tq->fifo_stream_index, max_size - tq->max_size);
+        if (ret >= 0)
+            tq->max_size = max_size;
+    }
+
+    pthread_mutex_unlock(&tq->lock);
+
+    return ret;
+}
+
+void tq_set_max_bytes(ThreadQueue *tq, size_t max_bytes)
+{
+    pthread_mutex_lock(&tq->lock);
+    tq->max_bytes = max_bytes;
+    pthread_cond_broadcast(&tq->cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
+void tq_enable_stats(ThreadQueue *tq)
+{
+    tq->stats = 1;
+}
+
+int tq_set_single_producer(ThreadQueue *tq)
+{
+    av_assert0(tq->nb_streams == 1);
+    av_assert0(!av_fifo_can_read(tq->fifo_stream_index));
+
+    if (tq->spsc)
+        return 0;
+
+    tq->ring       = av_calloc(tq->max_size, sizeof(*tq->ring));
+    tq->ring_entry = av_calloc(tq->max_size, sizeof(*tq->ring_entry));
+    if (!tq->ring || !tq->ring_entry)
+        return AVERROR(ENOMEM);
+    tq->ring_size = tq->max_size;
+
+    for (size_t i = 0; i < tq->ring_size; i++) {
+        tq->ring[i] = (tq->type == THREAD_QUEUE_FRAMES) ?
+                      (void*)av_frame_alloc() : (void*)av_packet_alloc();
+        if (!tq->ring[i])
+            return AVERROR(ENOMEM);
+    }
+
+    tq->spsc = 1;
+
+    return 0;
+}
+
+static size_t item_size(const ThreadQueue *tq, const void *data)
+{
+    size_t size = 0;
+
+    if (tq->type == THREAD_QUEUE_FRAMES) {
+        const AVFrame *frame = data;
+
+        for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+            size += frame->buf[i]->size;
+        for (int i = 0; i < frame->nb_extended_buf; i++)
+            size += frame->extended_buf[i]->size;
+    } else {
+        const AVPacket *pkt = data;
+
+        size = pkt->buf ? pkt->buf->size : pkt->size;
+    }
+
+    return size;
+}
+
+static void item_move(const ThreadQueue *tq, void *dst, void *src)
+{
+    if (tq->type == THREAD_QUEUE_FRAMES)
+        av_frame_move_ref(dst, src);
+    else
+        av_packet_move_ref(dst, src);
+}
+
+static void item_unref(const ThreadQueue *tq, void *data)
+{
+    if (tq->type == THREAD_QUEUE_FRAMES)
+        av_frame_unref(data);
+    else
+        av_packet_unref(data);
+}
+
+static size_t nb_queued(ThreadQueue *tq)
+{
+    if (tq->spsc)
+        return atomic_load(&tq->ring_tail) - atomic_load(&tq->ring_head);
+    return av_fifo_can_read(tq->fifo_stream_index);
+}
+
+static int queue_full(ThreadQueue *tq, size_t size)
+{
+    size_t queued = nb_queued(tq);
+
+    // always accept an item into an empty queue, so that the byte limit
+    // cannot stall the pipeline
+    if (!queued)
+        return 0;
+
+    return queued >= atomic_load(&tq->queue_size) ||
+           (tq->max_bytes && atomic_load(&tq->queued_bytes) + size > tq->max_bytes);
+}
+
+/**
+ * Called by the producer when the queue is full. If the consumer recently
+ * had to wait for input, the stages are running in bursts, so let the queue
+ * absorb them.
+ *
+ * @return 1 if the queue was grown, 0 otherwise
+ */
+static int queue_grow(ThreadQueue *tq)
+{
+    size_t queue_size = atomic_load(&tq->queue_size);
+
+    if (!atomic_load(&tq->recv_starved) || queue_size >= tq->max_size ||
+        nb_queued(tq) < queue_size)
+        return 0;
+
+    atomic_store(&tq->queue_size, FFMIN(queue_size * 2, tq->max_size));
+    atomic_store(&tq->recv_starved, 0);
+    return 1;
+}
+
+/**
+ * Called by the consumer for every received item, gives back space that went
+ * unused for a while.
+ */
+static void queue_shrink(ThreadQueue *tq, size_t queued)
+{
+    size_t queue_size;
+
+    if (tq->min_size == tq->max_size)
+        return;
+
+    queue_size = atomic_load(&tq->queue_size);
+
+    tq->window_max_queued = FFMAX(tq->window_max_queued, queued);
+    if (++tq->window_received < 16 * queue_size)
+        return;
+
+    if (queue_size > tq->min_size && tq->window_max_queued <= queue_size / 4)
+        atomic_store(&tq->queue_size, FFMAX(queue_size / 2, tq->min_size));
+
+    tq->window_received   = 0;
+    tq->window_max_queued = 0;
+}
+
+static int64_t stats_time(const ThreadQueue *tq)
+{
+    return tq->stats ? av_gettime_relative() : 0;
+}
+
+static void update_latency(ThreadQueue *tq, int64_t send_time)
+{
+    int64_t latency;
+    int bucket = 0;
+
+    if (!tq->stats)
+        return;
+
+    latency = av_gettime_relative() - send_time;
+
+    // buckets are a decade wide, starting below 100us
+    for (int64_t limit = 100; bucket < TQ_LATENCY_BUCKETS - 1 && latency >= limit;
+         limit *= 10)
+        bucket++;
+
+    atomic_fetch_add_explicit(&tq->latency[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&tq->nb_received, 1, memory_order_relaxed);
+}
+
+static void update_wait(const ThreadQueue *tq, atomic_int_least64_t *wait,
+                        int64_t wait_start)
+{
+    if (tq->stats)
+        atomic_fetch_add_explicit(wait, av_gettime_relative() - wait_start,
+                                  memory_order_relaxed);
+}
+
+static void update_max_queued(ThreadQueue *tq, size_t queued)
+{
+    // only ever updated by a single thread at a time
+    if (tq->stats &&
+        queued > atomic_load_explicit(&tq->max_queued, memory_order_relaxed))
+        atomic_store_explicit(&tq->max_queued, queued, memory_order_relaxed);
+}
+
+/**
+ * Wake up the other side of a single-producer queue, if it announced it is
+ * going to sleep. Since both sides announce sleeping before checking the ring
+ * state under the lock, and update the ring state before calling this, a
+ * wakeup cannot be missed.
+ */
+static void spsc_wake(ThreadQueue *tq, int sleeping)
+{
+    if (!(atomic_load(&tq->sleeping) & sleeping))
+        return;
+
+    pthread_mutex_lock(&tq->lock);
+    pthread_cond_broadcast(&tq->cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
+static int spsc_send(ThreadQueue *tq, void *data)
+{
+    atomic_int *finished = &tq->finished[0];
+    size_t tail = atomic_load_explicit(&tq->ring_tail, memory_order_relaxed);
+    size_t size, slot;
+
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    size = item_size(tq, data);
+
+    if (!(atomic_load(finished) & FINISHED_RECV) && queue_full(tq, size))
+        queue_grow(tq);
+
+    if (!(atomic_load(finished) & FINISHED_RECV) && queue_full(tq, size)) {
+        int64_t wait_start = stats_time(tq);
+
+        pthread_mutex_lock(&tq->lock);
+
+        atomic_fetch_or(&tq->sleeping, SLEEPING_SEND);
+        while (!(atomic_load(finished) & FINISHED_RECV) && queue_full(tq, size))
+            pthread_cond_wait(&tq->cond, &tq->lock);
+        atomic_fetch_and(&tq->sleeping, ~SLEEPING_SEND);
+
+        pthread_mutex_unlock(&tq->lock);
+
+        update_wait(tq, &tq->send_wait[0], wait_start);
+    }
+
+    if (atomic_load(finished) & FINISHED_RECV) {
+        atomic_fetch_or(finished, FINISHED_SEND);
+        return AVERROR_EOF;
+    }
+
+    slot = tail % tq->ring_size;
+
+    tq->ring_entry[slot] = (ThreadQueueEntry){ .size      = size,
+                                               .send_time = stats_time(tq) };
+    item_move(tq, tq->ring[slot], data);
+
+    atomic_fetch_add(&tq->queued_bytes, size);
+    atomic_store(&tq->ring_tail, tail + 1);
+
+    update_max_queued(tq, tail + 1 - atomic_load(&tq->ring_head));
+
+    spsc_wake(tq, SLEEPING_RECV);
+
+    return 0;
+}
+
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 {
-    int *finished;
+    atomic_int *finished;
+    size_t size;
     int ret;
 
     av_assert0(stream_idx < tq->nb_streams);
     finished = &tq->finished[stream_idx];
 
+    if (tq->spsc)
+        return spsc_send(tq, data);
+
     pthread_mutex_lock(&tq->lock);
 
-    if (*finished & FINISHED_SEND) {
+    if (atomic_load(finished) & FINISHED_SEND) {
         ret = AVERROR(EINVAL);
         goto finish;
     }
 
-    while (!(*finished & FINISHED_RECV) && !av_fifo_can_write(tq->fifo_stream_index))
-        pthread_cond_wait(&tq->cond, &tq->lock);
+    size = item_size(tq, data);
+
+    if (!(atomic_load(finished) & FINISHED_RECV) && queue_full(tq, size)) {
+        int64_t wait_start;
+
+        if (queue_grow(tq))
+            pthread_cond_broadcast(&tq->cond);
+
+        wait_start = stats_time(tq);
+
+        while (!(atomic_load(finished) & FINISHED_RECV) && queue_full(tq, size))
+            pthread_cond_wait(&tq->cond, &tq->lock);
+
+        update_wait(tq, &tq->send_wait[stream_idx], wait_start);
+    }
 
-    if (*finished & FINISHED_RECV) {
+    if (atomic_load(finished) & FINISHED_RECV) {
         ret = AVERROR_EOF;
-        *finished |= FINISHED_SEND;
+        atomic_fetch_or(finished, FINISHED_SEND);
     } else {
-        ret = av_fifo_write(tq->fifo_stream_index, &stream_idx, 1);
+        ThreadQueueEntry entry = { .stream_idx = stream_idx,
+                                   .size       = size,
+                                   .send_time  = stats_time(tq) };
+
+        ret = av_fifo_write(tq->fifo_stream_index, &entry, 1);
         if (ret < 0)
             goto finish;
 
@@ -143,6 +516,9 @@ int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
         if (ret < 0)
             goto finish;
 
+        atomic_fetch_add(&tq->queued_bytes, size);
+        update_max_queued(tq, av_fifo_can_read(tq->fifo_stream_index));
+
         pthread_cond_broadcast(&tq->cond);
     }
 
@@ -158,28 +534,35 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
     unsigned int nb_finished = 0;
 
     while (av_container_fifo_read(tq->fifo, data, 0) >= 0) {
-        unsigned idx;
+        ThreadQueueEntry entry;
         int ret;
 
-        ret = av_fifo_read(tq->fifo_stream_index, &idx, 1);
+        ret = av_fifo_read(tq->fifo_stream_index, &entry, 1);
         av_assert0(ret >= 0);
-        if (tq->finished[idx] & FINISHED_RECV) {
-            (tq->type == THREAD_QUEUE_FRAMES) ?
-            av_frame_unref(data) : av_packet_unref(data);
+
+        atomic_fetch_sub(&tq->queued_bytes, entry.size);
+        queue_shrink(tq, av_fifo_can_read(tq->fifo_stream_index) + 1);
+
+        if (atomic_load(&tq->finished[entry.stream_idx]) & FINISHED_RECV) {
+            item_unref(tq, data);
             continue;
         }
 
-        *stream_idx = idx;
+        update_latency(tq, entry.send_time);
+
+        *stream_idx = entry.stream_idx;
         return 0;
     }
 
     for (unsigned int i = 0; i < tq->nb_streams; i++) {
-        if (!tq->finished[i])
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (!finished)
             continue;
 
         /* return EOF to the consumer at most once for each stream */
-        if (!(tq->finished[i] & FINISHED_RECV)) {
-            tq->finished[i] |= FINISHED_RECV;
+        if (!(finished & FINISHED_RECV)) {
+            atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
             *stream_idx   = i;
             return AVERROR_EOF;
         }
@@ -190,12 +573,76 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
     return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
+static int spsc_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    atomic_int *finished = &tq->finished[0];
+    size_t head = atomic_load_explicit(&tq->ring_head, memory_order_relaxed);
+
+    while (1) {
+        // the producer marks the stream finished only after sending its last
+        // item, so the flags must be read before looking at the ring
+        int     fin  = atomic_load(finished);
+        size_t  tail = atomic_load(&tq->ring_tail);
+        int64_t wait_start;
+
+        if (tail != head) {
+            size_t slot = head % tq->ring_size;
+            ThreadQueueEntry entry = tq->ring_entry[slot];
+
+            item_move(tq, data, tq->ring[slot]);
+
+            atomic_fetch_sub(&tq->queued_bytes, entry.size);
+            queue_shrink(tq, tail - head);
+
+            atomic_store(&tq->ring_head, ++head);
+            spsc_wake(tq, SLEEPING_SEND);
+
+            if (fin & FINISHED_RECV) {
+                item_unref(tq, data);
+                continue;
+            }
+
+            update_latency(tq, entry.send_time);
+
+            *stream_idx = 0;
+            return 0;
+        }
+
+        if (fin & FINISHED_RECV)
+            return AVERROR_EOF;
+
+        /* return EOF to the consumer at most once */
+        if (fin & FINISHED_SEND) {
+            atomic_fetch_or(finished, FINISHED_RECV);
+            *stream_idx = 0;
+            return AVERROR_EOF;
+        }
+
+        wait_start = stats_time(tq);
+        atomic_store(&tq->recv_starved, 1);
+
+        pthread_mutex_lock(&tq->lock);
+
+        atomic_fetch_or(&tq->sleeping, SLEEPING_RECV);
+        while (!atomic_load(finished) && atomic_load(&tq->ring_tail) == head)
+            pthread_cond_wait(&tq->cond, &tq->lock);
+        atomic_fetch_and(&tq->sleeping, ~SLEEPING_RECV);
+
+        pthread_mutex_unlock(&tq->lock);
+
+        update_wait(tq, &tq->recv_wait, wait_start);
+    }
+}
+
 int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 {
     int ret;
 
     *stream_idx = -1;
 
+    if (tq->spsc)
+        return spsc_receive(tq, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
@@ -208,7 +655,12 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
             pthread_cond_broadcast(&tq->cond);
 
         if (ret == AVERROR(EAGAIN)) {
+            int64_t wait_start = stats_time(tq);
+
+            atomic_store(&tq->recv_starved, 1);
             pthread_cond_wait(&tq->cond, &tq->lock);
+
+            update_wait(tq, &tq->recv_wait, wait_start);
             continue;
         }
 
@@ -229,7 +681,7 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
     /* mark the stream as send-finished;
      * next time the consumer thread tries to read this stream it will get
      * an EOF and recv-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_SEND;
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
     pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
@@ -244,8 +696,36 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
     /* mark the stream as recv-finished;
      * next time the producer thread tries to send for this stream, it will
      * get an EOF and send-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_RECV;
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
     pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
 }
+
+void tq_stats(ThreadQueue *tq, ThreadQueueStats *stats)
+{
+    pthread_mutex_lock(&tq->lock);
+
+    stats->nb_queued    = nb_queued(tq);
+    stats->max_queued   = atomic_load_explicit(&tq->max_queued, memory_order_relaxed);
+    stats->queue_size   = atomic_load_explicit(&tq->queue_size, memory_order_relaxed);
+    stats->queued_bytes = atomic_load_explicit(&tq->queued_bytes, memory_order_relaxed);
+    stats->nb_received  = atomic_load_explicit(&tq->nb_received, memory_order_relaxed);
+    stats->recv_wait    = atomic_load_explicit(&tq->recv_wait, memory_order_relaxed);
+
+    stats->send_wait    = 0;
+    for (unsigned int i = 0; i < tq->nb_streams; i++)
+        stats->send_wait += atomic_load_explicit(&tq->send_wait[i], memory_order_relaxed);
+
+    for (int i = 0; i < TQ_LATENCY_BUCKETS; i++)
+        stats->latency[i] = atomic_load_explicit(&tq->latency[i], memory_order_relaxed);
+
+    pthread_mutex_unlock(&tq->lock);
+}
+
+int64_t tq_send_wait(ThreadQueue *tq, unsigned int stream_idx)
+{
+    av_assert0(stream_idx < tq->nb_streams);
+
+    return atomic_load_explicit(&tq->send_wait[stream_idx], memory_order_relaxed);
+}
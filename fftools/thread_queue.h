@@ -19,6 +19,7 @@
 #ifndef FFTOOLS_THREAD_QUEUE_H
 #define FFTOOLS_THREAD_QUEUE_H
 
+#include <stdint.h>
 #include <string.h>
 
 enum ThreadQueueType {
@@ -28,6 +29,45 @@ enum ThreadQueueType {
 
 typedef struct ThreadQueue ThreadQueue;
 
+/**
+ * Number of buckets in the latency histogram of ThreadQueueStats. Bucket i
+ * counts the items that spent less than 100 * 10^i microseconds in the queue,
+ * the last bucket counts all the remaining ones.
+ */
+#define TQ_LATENCY_BUCKETS 6
+
+typedef struct ThreadQueueStats {
+    /**
+     * Number of items currently in the queue, the largest number of items
+     * that were ever queued at once, and the maximum queue size.
+     */
+    size_t   nb_queued;
+    size_t   max_queued;
+    size_t   queue_size;
+
+    /**
+     * Total size of the data of the items currently in the queue.
+     */
+    size_t   queued_bytes;
+
+    /**
+     * Number of items returned by tq_receive().
+     */
+    uint64_t nb_received;
+
+    /**
+     * Total time in microseconds the consumer spent waiting for an item to
+     * become available and the producers spent waiting for free space.
+     */
+    int64_t  recv_wait;
+    int64_t  send_wait;
+
+    /**
+     * Histogram of the time the received items spent in the queue.
+     */
+    uint64_t latency[TQ_LATENCY_BUCKETS];
+} ThreadQueueStats;
+
 /**
  * Allocate a queue for sending data between threads.
  *
@@ -40,6 +80,46 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
                       enum ThreadQueueType type);
 void         tq_free(ThreadQueue **tq);
 
+/**
+ * Allow the queue to grow beyond the size passed to tq_alloc().
+ *
+ * The queue is grown when the producer finds it full after the consumer had
+ * to wait for input, i.e. when the stages connected by the queue run in
+ * bursts, and is shrunk back to its initial size when the extra space goes
+ * unused.
+ *
+ * @param max_size maximum number of items that can be stored in the queue
+ */
+int tq_set_max_size(ThreadQueue *tq, size_t max_size);
+
+/**
+ * Limit the total size of the data of the items stored in the queue. Sending
+ * blocks while the new item would exceed the limit, unless the queue is empty.
+ *
+ * @param max_bytes maximum size in bytes, 0 for no limit
+ */
+void tq_set_max_bytes(ThreadQueue *tq, size_t max_bytes);
+
+/**
+ * Collect the timing and occupancy statistics returned by tq_stats() and
+ * tq_send_wait(); they are all 0 otherwise. Collecting them costs reading
+ * the clock for every item, so it is off by default.
+ *
+ * Must be called before any items are sent.
+ */
+void tq_enable_stats(ThreadQueue *tq);
+
+/**
+ * Declare that items are only ever sent to the queue by a single thread
+ * (finishing the stream may still be done from anywhere). The queue then
+ * switches to a lock-free ring buffer, so that sending and receiving only
+ * take the lock when they need to wait for the other side.
+ *
+ * Only supported for queues with a single stream. Must be called before any
+ * items are sent and after tq_set_max_size().
+ */
+int tq_set_single_producer(ThreadQueue *tq);
+
 /**
  * Send an item for the given stream to the queue.
  *
@@ -78,4 +158,15 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
  */
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx);
 
+/**
+ * Get the current statistics for the queue. May be called from any thread.
+ */
+void tq_stats(ThreadQueue *tq, ThreadQueueStats *stats);
+
+/**
+ * Get the total time in microseconds the producers spent waiting for free
+ * space in the queue while sending items for the given stream.
+ */
+int64_t tq_send_wait(ThreadQueue *tq, unsigned int stream_idx);
+
 #endif // FFTOOLS_THREAD_QUEUE_H
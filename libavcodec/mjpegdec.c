@@ -30,6 +30,8 @@
  * MJPEG decoder.
  */
 
+#include <stdatomic.h>
+
 #include "config_components.h"
 
 #include "libavutil/display.h"
@@ -816,10 +818,11 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_WARNING,
                "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n",
@@ -828,46 +831,47 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if (code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb, int *last_dc,
+                        int16_t *block, int component,
                         int dc_index, int ac_index, uint16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = val * (unsigned)quant_matrix[0] + s->last_dc[component];
-    s->last_dc[component] = val;
+    val = val * (unsigned)quant_matrix[0] + last_dc[component];
+    last_dc[component] = val;
     block[0] = av_clip_int16(val);
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, gb);
+        GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if (code) {
             if (code > MIN_CACHE_BITS - 16)
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, gb);
 
             {
-                int cache = GET_CACHE(re, &s->gb);
+                int cache = GET_CACHE(re, gb);
                 int sign  = (~cache) >> 31;
                 level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -877,7 +881,7 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
             block[j] = level * quant_matrix[i];
         }
     } while (i < 63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, gb);}
 
     return 0;
 }
@@ -888,7 +892,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
 {
     unsigned val;
     s->bdsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &s->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
@@ -1182,7 +1186,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int nb_components, int p
                 topleft[i] = top[i];
                 top[i]     = buffer[mb_x][i];
 
-                dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                 if(dc == 0xFFFFF)
                     return -1;
 
@@ -1316,7 +1320,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for(j=0; j<n; j++) {
                         int pred, dc;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1387,7 +1391,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1456,6 +1460,109 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
+typedef struct MJpegScanSlices {
+    int nb_components;
+    int nb_segments;
+    int nb_jobs;
+    atomic_int errors;
+} MJpegScanSlices;
+
+static int decode_mcu(MJpegDecodeContext *s, GetBitContext *gb, int *last_dc,
+                      int16_t *block, int nb_components, int mb_x, int mb_y,
+                      int chroma_width, int chroma_height)
+{
+    int bytes_per_pixel = 1 + (s->bits > 8);
+
+    for (int i = 0; i < nb_components; i++) {
+        int c = s->comp_index[i];
+        int h = s->h_scount[i];
+        int v = s->v_scount[i];
+        int x = 0, y = 0;
+
+        for (int j = 0; j < s->nb_blocks[i]; j++) {
+            int block_offset = (((s->linesize[c] * (v * mb_y + y) * 8) +
+                                 (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
+
+            if (s->interlaced && s->bottom_field)
+                block_offset += s->linesize[c] >> 1;
+
+            s->bdsp.clear_block(block);
+            if (decode_block(s, gb, last_dc, block, i,
+                             s->dc_index[i], s->ac_index[i],
+                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
+                av_log(s->avctx, AV_LOG_ERROR,
+                       "error y=%d x=%d\n", mb_y, mb_x);
+                return AVERROR_INVALIDDATA;
+            }
+            if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
+                && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)
+                && s->linesize[c]) {
+                uint8_t *ptr = s->picture_ptr->data[c] + block_offset;
+
+                s->idsp.idct_put(ptr, s->linesize[c], block);
+                if (s->bits & 7)
+                    shift_output(s, ptr, s->linesize[c]);
+            }
+            if (++x == h) {
+                x = 0;
+                y++;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Decode a range of the restart intervals of a sequential scan. The DC
+ * predictors are reset at every RSTn marker, so the intervals can be decoded
+ * independently of each other.
+ */
+static int decode_restart_intervals(AVCodecContext *avctx, void *arg,
+                                    int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    MJpegScanSlices  *sl = arg;
+    const int first    = (int64_t)sl->nb_segments *  jobnr      / sl->nb_jobs;
+    const int last     = (int64_t)sl->nb_segments * (jobnr + 1) / sl->nb_jobs;
+    const int nb_mcus  = s->mb_width * s->mb_height;
+    const int buf_size = s->gb.size_in_bits >> 3;
+    int chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
+    LOCAL_ALIGNED_32(int16_t, block, [64]);
+
+    av_pix_fmt_get_chroma_sub_sample(avctx->pix_fmt, &chroma_h_shift,
+                                     &chroma_v_shift);
+    chroma_width  = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
+    chroma_height = AV_CEIL_RSHIFT(s->height, chroma_v_shift);
+
+    for (int seg = first; seg < last; seg++) {
+        int start   = seg ? s->restart_offsets[seg - 1] + 2 : get_bits_count(&s->gb) >> 3;
+        int end     = seg < sl->nb_segments - 1 ? s->restart_offsets[seg] : buf_size;
+        int mcu_end = FFMIN(nb_mcus, (seg + 1) * s->restart_interval);
+        int last_dc[MAX_COMPONENTS];
+        GetBitContext gb;
+        int ret;
+
+        for (int i = 0; i < sl->nb_components; i++)
+            last_dc[i] = 4 << s->bits;
+
+        ret = init_get_bits8(&gb, s->gb.buffer + start, end - start);
+        for (int mcu = seg * s->restart_interval; mcu < mcu_end && ret >= 0; mcu++) {
+            if (get_bits_left(&gb) < 0) {
+                av_log(avctx, AV_LOG_ERROR, "overread %d\n", -get_bits_left(&gb));
+                ret = AVERROR_INVALIDDATA;
+            } else
+                ret = decode_mcu(s, &gb, last_dc, block, sl->nb_components,
+                                 mcu % s->mb_width, mcu / s->mb_width,
+                                 chroma_width, chroma_height);
+        }
+        if (ret < 0)
+            atomic_fetch_add_explicit(&sl->errors, 1, memory_order_relaxed);
+    }
+
+    emms_c();
+    return 0;
+}
+
 static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                              int Al, const uint8_t *mb_bitmask,
                              int mb_bitmask_size,
@@ -1491,6 +1598,30 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         s->coefs_finished[c] |= 1;
     }
 
+    /* Decode the restart intervals in parallel if all their markers were
+     * found where they are expected. */
+    if (!s->progressive && !mb_bitmask && s->restart_interval &&
+        (s->avctx->active_thread_type & FF_THREAD_SLICE)) {
+        MJpegScanSlices sl = {
+            .nb_components = nb_components,
+            .nb_segments   = (s->mb_width * s->mb_height + s->restart_interval - 1) /
+                             s->restart_interval,
+        };
+
+        if (sl.nb_segments > 1 && s->nb_restart_offsets == sl.nb_segments - 1 &&
+            s->restart_offsets[0] >= get_bits_count(&s->gb) >> 3) {
+            sl.nb_jobs = FFMIN(sl.nb_segments, s->avctx->thread_count);
+            atomic_init(&sl.errors, 0);
+
+            s->avctx->execute2(s->avctx, decode_restart_intervals, &sl, NULL,
+                               sl.nb_jobs);
+
+            skip_bits_long(&s->gb, get_bits_left(&s->gb));
+            return atomic_load_explicit(&sl.errors, memory_order_relaxed) ?
+                   AVERROR_INVALIDDATA : 0;
+        }
+    }
+
     for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
         for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
             const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
@@ -1532,7 +1663,7 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
 
                         } else {
                             s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
+                            if (decode_block(s, &s->gb, s->last_dc, s->block, i,
                                              s->dc_index[i], s->ac_index[i],
                                              s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                                 av_log(s->avctx, AV_LOG_ERROR,
@@ -2242,6 +2373,8 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
         const uint8_t *ptr = src;
         uint8_t *dst = s->buffer;
 
+        s->nb_restart_offsets = 0;
+
         #define copy_data_segment(skip) do {       \
             ptrdiff_t length = (ptr - src) - (skip);  \
             if (length > 0) {                         \
@@ -2279,6 +2412,17 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         copy_data_segment(1);
                         if (x)
                             break;
+                    } else if (s->avctx->active_thread_type & FF_THREAD_SLICE) {
+                        /* the marker is kept, remember where it will end up */
+                        int *offsets = av_fast_realloc(s->restart_offsets,
+                                                       &s->restart_offsets_size,
+                                                       (s->nb_restart_offsets + 1) *
+                                                       sizeof(*s->restart_offsets));
+                        if (!offsets)
+                            return AVERROR(ENOMEM);
+                        s->restart_offsets = offsets;
+                        s->restart_offsets[s->nb_restart_offsets++] =
+                            (dst - s->buffer) + (ptr - src) - 2;
                     }
                 }
             }
@@ -2900,6 +3044,7 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_frame_free(&s->smv_frame);
 
     av_freep(&s->buffer);
+    av_freep(&s->restart_offsets);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
@@ -2957,7 +3102,7 @@ const FFCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     FF_CODEC_DECODE_CB(ff_mjpeg_decode_frame),
     .flush          = decode_flush,
-    .p.capabilities = AV_CODEC_CAP_DR1,
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .p.max_lowres   = 3,
     .p.priv_class   = &mjpegdec_class,
     .p.profiles     = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
@@ -124,6 +124,13 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    /**
+     * Offsets of the RSTn markers in the unescaped buffer of the current
+     * scan, only collected for slice threading.
+     */
+    int *restart_offsets;
+    unsigned int restart_offsets_size;
+    int nb_restart_offsets;
 
     int buggy_avid;
     int cs_itu601;
@@ -297,6 +297,7 @@ extern const FFFilter ff_vf_floodfill;
 extern const FFFilter ff_vf_format;
 extern const FFFilter ff_vf_fps;
 extern const FFFilter ff_vf_framepack;
+extern const FFFilter ff_vf_frameparallel;
 extern const FFFilter ff_vf_framerate;
 extern const FFFilter ff_vf_framestep;
 extern const FFFilter ff_vf_freezedetect;
@@ -340,6 +341,7 @@ extern const FFFilter ff_vf_interlace_vulkan;
 extern const FFFilter ff_vf_interleave;
 extern const FFFilter ff_vf_kerndeint;
 extern const FFFilter ff_vf_kirsch;
+extern const FFFilter ff_vf_ladder;
 extern const FFFilter ff_vf_lagfun;
 extern const FFFilter ff_vf_latency;
 extern const FFFilter ff_vf_lcevc;
@@ -98,6 +98,7 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *ret = NULL;
+    int profile = ff_filter_profile_alloc_start(link);
 
     if (link->dstpad->get_buffer.audio)
         ret = link->dstpad->get_buffer.audio(link, nb_samples);
@@ -105,6 +106,9 @@ AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples)
     if (!ret)
         ret = ff_default_get_audio_buffer(link, nb_samples);
 
+    if (profile)
+        ff_filter_profile_alloc_end(link, ret);
+
     return ret;
 }
 
@@ -19,6 +19,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#include <time.h>
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
@@ -34,6 +38,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
 
 #include "audio.h"
 #include "avfilter.h"
@@ -229,6 +234,11 @@ static void update_link_current_pts(FilterLinkInternal *li, int64_t pts)
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
     FFFilterContext *ctxi = fffilterctx(filter);
+    if (!ctxi->ready && priority && filter->graph) {
+        ctxi->ready = priority;
+        ff_graph_ready_map_update(ctxi);
+        return;
+    }
     ctxi->ready = FFMAX(ctxi->ready, priority);
 }
 
@@ -834,6 +844,7 @@ void avfilter_free(AVFilterContext *filter)
     av_expr_free(ctxi->enable);
     ctxi->enable = NULL;
     av_freep(&ctxi->var_values);
+    av_freep(&ctxi->fused);
     av_free(filter);
 }
 
@@ -1027,6 +1038,182 @@ static int evaluate_timeline_at_frame(AVFilterLink *link, const AVFrame *frame)
     return fabs(av_expr_eval(dsti->enable, dsti->var_values, NULL)) >= 0.5;
 }
 
+/**
+ * Approximate size in bytes of the bands of frames filtered by fused filters.
+ */
+#define FUSED_BAND_SIZE (64 * 1024)
+
+typedef struct FusedThreadData {
+    AVFilterContext **filters;
+    int            nb_filters;
+    const AVFrame   *in;
+    AVFrame         *out;
+} FusedThreadData;
+
+static int filter_rows_fused(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const FusedThreadData *td = arg;
+    const int h       = td->out->height;
+    const int y_start = (h *  jobnr   ) / nb_jobs;
+    const int y_end   = (h * (jobnr+1)) / nb_jobs;
+    const AVFrame *in = td->in;
+
+    for (int i = 0; i < td->nb_filters; i++) {
+        AVFilterContext *f = td->filters[i];
+
+        fffilter(f->filter)->filter_rows(f, in, td->out, y_start, y_end);
+        in = td->out;
+    }
+
+    return 0;
+}
+
+/**
+ * Get the number of bytes in a row of a frame, summed over all its planes.
+ */
+static int fused_row_bytes(const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int row_bytes = 0;
+
+    for (int p = 0; p < 4 && frame->data[p]; p++)
+        row_bytes += FFABS(frame->linesize[p]) >>
+                     (p == 1 || p == 2 ? desc->log2_chroma_h : 0);
+    return FFMAX(row_bytes, 1);
+}
+
+/**
+ * Filter a frame through a chain of fused filters one stripe at a time, see
+ * FFFilter.rows_radius. frames[i] and frames[i + 1] are the input and output
+ * of filters[i].
+ */
+static void filter_stripes_fused(AVFilterContext **filters, AVFrame **frames,
+                                 int nb_filters)
+{
+    const int h = frames[nb_filters]->height;
+    int radius[MAX_FUSED_FILTERS], done[MAX_FUSED_FILTERS] = { 0 };
+    int band = (FUSED_BAND_SIZE + fused_row_bytes(frames[nb_filters]) - 1) /
+               fused_row_bytes(frames[nb_filters]);
+
+    for (int i = 0; i < nb_filters; i++) {
+        const FFFilter *fi = fffilter(filters[i]->filter);
+
+        radius[i] = fi->rows_radius ? fi->rows_radius(filters[i]) : 0;
+        // limit the rows filtered again by the next stripe
+        band = radius[i] < 0 ? h : FFMAX(band, 8 * radius[i]);
+    }
+
+    for (int y = 0; done[nb_filters - 1] < h;) {
+        y = FFMIN(y + band, h);
+
+        // every filter gets the rows whose neighborhood the previous one has
+        // output, all of them at the end of the frame
+        for (int i = 0; i < nb_filters; i++) {
+            int end = !i ? y : done[i - 1] == h ? h :
+                      FFMAX(done[i - 1] - radius[i], done[i]);
+
+            if (end > done[i]) {
+                fffilter(filters[i]->filter)->filter_rows(filters[i], frames[i],
+                                                          frames[i + 1],
+                                                          done[i], end);
+                done[i] = end;
+            }
+        }
+    }
+}
+
+/**
+ * Filter a frame through a chain of fused filters, see FFFilter.filter_rows.
+ * The commands and timeline of the first filter of the chain must have been
+ * processed already.
+ */
+static int filter_frame_fused(AVFilterLink *link, AVFrame *in)
+{
+    FFFilterContext *ctxi = fffilterctx(link->dst);
+    AVFilterContext *last = ctxi->fused[ctxi->nb_fused - 1];
+    AVFilterContext *filters[MAX_FUSED_FILTERS];
+    AVFrame *frames[MAX_FUSED_FILTERS + 1] = { in };
+    AVFrame *out;
+    int nb_filters = 0, stripes = 0, ret;
+
+    for (int i = 0; i < ctxi->nb_fused; i++) {
+        AVFilterContext *f = ctxi->fused[i];
+        FilterLink *l = ff_filter_link(f->inputs[0]);
+
+        /* the first link is taken care of by filter_frame_framed(), update
+           the others as if the frame went through them */
+        if (i) {
+            l->frame_count_in++;
+            ff_inlink_process_commands(f->inputs[0], in);
+            f->is_disabled = !evaluate_timeline_at_frame(f->inputs[0], in);
+        }
+
+        if (!f->is_disabled && fffilter(f->filter)->filter_rows)
+            filters[nb_filters++] = f;
+
+        if (i)
+            l->frame_count_out++;
+    }
+
+    /* the filters work in place, except those reading neighborhoods of
+       pixels which need their own output */
+    for (int i = 0; i < nb_filters; i++) {
+        const FFFilter *fi = fffilter(filters[i]->filter);
+
+        frames[i + 1] = frames[i];
+        stripes      |= !!fi->rows_radius;
+        if (fi->rows_radius || (frames[i] == in && !av_frame_is_writable(in))) {
+            frames[i + 1] = ff_get_video_buffer(last->outputs[0], in->width, in->height);
+            if (!frames[i + 1]) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+            ret = av_frame_copy_props(frames[i + 1], in);
+            if (ret < 0)
+                goto fail;
+        }
+    }
+    out = frames[nb_filters];
+
+    for (int i = 0; i < nb_filters; i++) {
+        const FFFilter *fi = fffilter(filters[i]->filter);
+
+        if (fi->prepare_rows) {
+            ret = fi->prepare_rows(filters[i], out);
+            if (ret < 0)
+                goto fail;
+        }
+    }
+
+    if (stripes) {
+        filter_stripes_fused(filters, frames, nb_filters);
+    } else if (nb_filters) {
+        FusedThreadData td = { .filters = filters, .nb_filters = nb_filters,
+                               .in = in, .out = out };
+        int nb_jobs;
+
+        // cut the frame in bands small enough to stay in cache between filters
+        nb_jobs = ((int64_t)fused_row_bytes(out) * out->height + FUSED_BAND_SIZE - 1) / FUSED_BAND_SIZE;
+        nb_jobs = FFMAX(nb_jobs, ff_filter_get_nb_threads(link->dst));
+        nb_jobs = av_clip(nb_jobs, 1, out->height);
+
+        ff_filter_execute(link->dst, filter_rows_fused, &td, NULL, nb_jobs);
+    }
+
+    for (int i = 0; i < nb_filters; i++)
+        if (frames[i] != frames[i + 1])
+            av_frame_free(&frames[i]);
+
+    return ff_filter_frame(last->outputs[0], out);
+
+fail:
+    for (int i = nb_filters; i > 0; i--)
+        if (frames[i] != frames[i - 1])
+            av_frame_free(&frames[i]);
+    av_frame_free(&frames[0]);
+    return ret;
+}
+
 static int filter_frame_framed(AVFilterLink *link, AVFrame *frame)
 {
     FilterLink *l = ff_filter_link(link);
@@ -1038,18 +1225,20 @@ static int filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     if (!(filter_frame = dst->filter_frame))
         filter_frame = default_filter_frame;
 
-    if (dst->flags & AVFILTERPAD_FLAG_NEEDS_WRITABLE) {
-        ret = ff_inlink_make_frame_writable(link, &frame);
-        if (ret < 0)
-            goto fail;
-    }
-
     ff_inlink_process_commands(link, frame);
     dstctx->is_disabled = !evaluate_timeline_at_frame(link, frame);
 
     if (dstctx->is_disabled &&
         (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
         filter_frame = default_filter_frame;
+    /* frames passed through untouched by the timeline need no copy */
+    else if (dst->flags & AVFILTERPAD_FLAG_NEEDS_WRITABLE) {
+        ret = ff_inlink_make_frame_writable(link, &frame);
+        if (ret < 0)
+            goto fail;
+    }
+    if (fffilterctx(dstctx)->fused)
+        filter_frame = filter_frame_fused;
     ret = filter_frame(link, frame);
     l->frame_count_out++;
     return ret;
@@ -1106,6 +1295,7 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
         av_frame_free(&frame);
         return ret;
     }
+    li->max_queued = FFMAX(li->max_queued, ff_framequeue_queued_frames(&li->fifo));
     ff_filter_set_ready(link->dst, 300);
     return 0;
 
@@ -1438,17 +1628,67 @@ static int filter_activate_default(AVFilterContext *filter)
      input, so we need to do it for them.
  */
 
+/**
+ * @return the monotonic time, or with cpu the CPU time of the calling thread
+ *         (0 if not available), in nanoseconds
+ */
+static int64_t profile_clock(int cpu)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_MONOTONIC) && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (!clock_gettime(cpu ? CLOCK_THREAD_CPUTIME_ID : CLOCK_MONOTONIC, &ts))
+        return ts.tv_sec * INT64_C(1000000000) + ts.tv_nsec;
+#endif
+    return cpu ? 0 : av_gettime_relative() * 1000;
+}
+
+int ff_filter_profile_alloc_start(AVFilterLink *link)
+{
+    AVFilterGraph *graph = link->src->graph;
+
+    if (!graph || !graph->profile)
+        return 0;
+    fffiltergraph(graph)->prof_alloc_nesting++;
+    return 1;
+}
+
+void ff_filter_profile_alloc_end(AVFilterLink *link, const AVFrame *frame)
+{
+    FFFilterContext *ctxi = fffilterctx(link->src);
+
+    if (--fffiltergraph(link->src->graph)->prof_alloc_nesting || !frame)
+        return;
+    if (ctxi->fused_into)
+        ctxi = fffilterctx(ctxi->fused_into);
+    for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+        ctxi->prof_alloc_bytes += frame->buf[i]->size;
+    for (int i = 0; i < frame->nb_extended_buf; i++)
+        ctxi->prof_alloc_bytes += frame->extended_buf[i]->size;
+}
+
 int ff_filter_activate(AVFilterContext *filter)
 {
     FFFilterContext *ctxi = fffilterctx(filter);
     const FFFilter *const fi = fffilter(filter->filter);
+    int64_t wall = 0, cpu = 0;
+    int profile = filter->graph->profile;
     int ret;
 
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(fi->p.flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  fi->activate));
     ctxi->ready = 0;
+    ff_graph_ready_map_update(ctxi);
+    if (profile) {
+        wall = profile_clock(0);
+        cpu  = profile_clock(1);
+    }
     ret = fi->activate ? fi->activate(filter) : filter_activate_default(filter);
+    if (profile) {
+        ctxi->prof_activations++;
+        ctxi->prof_wall_time += profile_clock(0) - wall;
+        ctxi->prof_cpu_time  += profile_clock(1) - cpu;
+    }
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
@@ -1563,6 +1803,8 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
     if (av_frame_is_writable(frame))
         return 0;
     av_log(link->dst, AV_LOG_DEBUG, "Copying data in avfilter.\n");
+    if (link->dst->graph && link->dst->graph->profile)
+        fffilterctx(link->dst)->prof_copies++;
 
     switch (link->type) {
     case AVMEDIA_TYPE_VIDEO:
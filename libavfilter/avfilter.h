@@ -265,6 +265,19 @@ unsigned avfilter_filter_pad_count(const AVFilter *filter, int is_output);
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Fuse chains of filters which filter each pixel independently.
+ */
+#define AVFILTER_FUSE_PIXEL   (1 << 0)
+/**
+ * Also fuse filters which filter neighborhoods of pixels (e.g. convolutions),
+ * streaming stripes of the frames from one filter to the next. The stripes of
+ * a frame are filtered one after the other, so this trades slice threading for
+ * cache locality and is best used when frames are processed in parallel
+ * otherwise, e.g. with several filtergraphs.
+ */
+#define AVFILTER_FUSE_STRIPES (1 << 1)
+
 /** An instance of a filter */
 typedef struct AVFilterContext {
     const AVClass *av_class;        ///< needed for av_log() and filters common options
@@ -637,6 +650,35 @@ typedef struct AVFilterGraph {
      * avfilter_graph_config().
      */
     unsigned max_buffered_frames;
+
+    /**
+     * Fuse chains of filters, so that the frames go through all the filters
+     * of the chain band by band while they are in cache, instead of one whole
+     * frame at a time through each filter. A combination of AVFILTER_FUSE_*
+     * flags.
+     *
+     * Defaults to AVFILTER_FUSE_PIXEL. This field must be set before calling
+     * avfilter_graph_config().
+     */
+    int fuse_filters;
+
+    /**
+     * Maximum number of bytes of video frame buffers, in use or pooled for
+     * reuse, allocated by the filters of the graph. When it is exceeded, the
+     * least recently used pools of buffers are released.
+     *
+     * Zero means no limit. This field must be set before calling
+     * avfilter_graph_config().
+     */
+    int64_t frame_pool_size;
+
+    /**
+     * If set, record for each filter of the graph the number of activations,
+     * the time spent in them and the size of the frame buffers it allocated,
+     * and for each link the largest number of frames queued in it. See
+     * avfilter_graph_dump_profile().
+     */
+    int profile;
 } AVFilterGraph;
 
 /**
@@ -1188,6 +1230,25 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
  */
 char *avfilter_graph_dump(AVFilterGraph *graph, const char *options);
 
+/**
+ * Dump the profiling data recorded for each filter of a graph with
+ * AVFilterGraph.profile set.
+ *
+ * The filters of a fused chain, see AVFilterGraph.fuse_filters, are run by
+ * the first filter of the chain, to which all their profiling data but the
+ * frame counts is accounted. The other filters are marked as fused into it.
+ *
+ * @param graph   the graph to dump
+ * @param format  "text" or NULL for a human-readable table, "json" for a
+ *                JSON representation
+ * @param dump    set to the resulting string on success, which must be freed
+ *                using av_free
+ * @return  0 on success, AVERROR(EINVAL) if format is not known, another
+ *          negative AVERROR code on other failures
+ */
+int avfilter_graph_dump_profile(AVFilterGraph *graph, const char *format,
+                                char **dump);
+
 /**
  * Request a frame on the oldest sink link.
  *
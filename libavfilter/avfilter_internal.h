@@ -34,6 +34,10 @@
 typedef struct FilterLinkInternal {
     FilterLink l;
 
+    /**
+     * Pool of audio frame buffers. Video frame buffers are allocated from
+     * FFFilterGraph.frame_pools.
+     */
     struct FFFramePool *frame_pool;
 
     /**
@@ -79,6 +83,11 @@ typedef struct FilterLinkInternal {
      */
     int age_index;
 
+    /**
+     * Largest number of frames queued in fifo.
+     */
+    size_t max_queued;
+
     /** stage of the initialization of the link properties (dimensions, etc) */
     enum {
         AVLINK_UNINIT = 0,      ///< not started
@@ -110,14 +119,50 @@ typedef struct FFFilterContext {
      */
     unsigned ready;
 
+    /**
+     * Index of the filter in AVFilterGraph.filters.
+     */
+    unsigned graph_index;
+
+    /**
+     * Profiling data, only recorded if AVFilterGraph.profile is set.
+     * Times are in nanoseconds, CPU time is the time of the thread running
+     * the graph, it does not include slice threads.
+     */
+    uint64_t prof_activations;
+    int64_t  prof_wall_time;
+    int64_t  prof_cpu_time;
+    uint64_t prof_alloc_bytes;
+    /// input frames copied because they were not writable
+    uint64_t prof_copies;
+
     /// parsed expression
     struct AVExpr *enable;
     /// variable values for the enable expression
     double *var_values;
 
     struct AVFilterCommand *command_queue;
+
+    /**
+     * Chain of filters fused by the filtergraph starting with this one, see
+     * FFFilter.filter_rows. NULL if the filter is not the first of such a
+     * chain.
+     */
+    AVFilterContext **fused;
+    int            nb_fused;
+
+    /**
+     * First filter of the fused chain this filter is part of, which runs
+     * it. NULL if the filter is not fused or is the first of its chain.
+     */
+    AVFilterContext *fused_into;
 } FFFilterContext;
 
+/**
+ * Maximum number of filters fused into one chain.
+ */
+#define MAX_FUSED_FILTERS 16
+
 static inline FFFilterContext *fffilterctx(AVFilterContext *ctx)
 {
     return (FFFilterContext*)ctx;
@@ -145,6 +190,26 @@ typedef struct FFFilterGraph {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Pools of video frame buffers shared by all the links of the graph.
+     */
+    struct FFFramePoolSet *frame_pools;
+
+    /**
+     * Bitmap of the filters that need activating, i.e. with a non-0
+     * FFFilterContext.ready, indexed by FFFilterContext.graph_index.
+     * It spares ff_filter_graph_run_once() from looking at every filter.
+     */
+    uint64_t *ready_map;
+    unsigned  ready_map_size;
+
+    /**
+     * Nesting level of the ff_get_*_buffer() calls of a profiled graph, so
+     * that buffers requested through pass-through get_buffer callbacks are
+     * accounted once, to the filter which requested them.
+     */
+    unsigned prof_alloc_nesting;
 } FFFilterGraph;
 
 static inline FFFilterGraph *fffiltergraph(AVFilterGraph *graph)
@@ -152,6 +217,15 @@ static inline FFFilterGraph *fffiltergraph(AVFilterGraph *graph)
     return (FFFilterGraph*)graph;
 }
 
+static inline void ff_graph_ready_map_update(FFFilterContext *ctxi)
+{
+    FFFilterGraph *graphi = fffiltergraph(ctxi->p.graph);
+    uint64_t *word = &graphi->ready_map[ctxi->graph_index >> 6];
+    uint64_t  bit  = 1ULL << (ctxi->graph_index & 63);
+
+    *word = ctxi->ready ? *word | bit : *word & ~bit;
+}
+
 /**
  * Update the position of a link in the age heap.
  */
@@ -175,6 +249,22 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
 
 int ff_filter_activate(AVFilterContext *filter);
 
+/**
+ * Start a buffer allocation for a link, to be ended by
+ * ff_filter_profile_alloc_end().
+ *
+ * @return nonzero if the graph is profiled
+ */
+int ff_filter_profile_alloc_start(AVFilterLink *link);
+
+/**
+ * End a buffer allocation started by ff_filter_profile_alloc_start() which
+ * returned nonzero. If it is the outermost one, account the buffers of the
+ * frame to the source filter of the link, or to the first filter of the
+ * fused chain it is part of.
+ */
+void ff_filter_profile_alloc_end(AVFilterLink *link, const AVFrame *frame);
+
 /**
  * Parse filter options into a dictionary.
  *
@@ -28,6 +28,7 @@
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/intmath.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
@@ -38,6 +39,7 @@
 #include "buffersink.h"
 #include "filters.h"
 #include "formats.h"
+#include "framepool.h"
 #include "framequeue.h"
 #include "video.h"
 
@@ -58,6 +60,14 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
     {"max_buffered_frames"  , "maximum number of buffered frames allowed", OFFSET(max_buffered_frames),
         AV_OPT_TYPE_UINT,   {.i64 = 0}, 0, UINT_MAX, F|V|A },
+    {"fuse_filters"         , "fuse chains of filters", OFFSET(fuse_filters),
+        AV_OPT_TYPE_FLAGS,  {.i64 = AVFILTER_FUSE_PIXEL}, 0, INT_MAX, F|V, .unit = "fuse_filters" },
+        {"pixel",   "fuse per-pixel filters", 0, AV_OPT_TYPE_CONST, {.i64 = AVFILTER_FUSE_PIXEL }, .flags = F|V, .unit = "fuse_filters"},
+        {"stripes", "stream stripes between neighborhood filters", 0, AV_OPT_TYPE_CONST, {.i64 = AVFILTER_FUSE_STRIPES }, .flags = F|V, .unit = "fuse_filters"},
+    {"frame_pool_size"      , "maximum size in bytes of the video frame buffers", OFFSET(frame_pool_size),
+        AV_OPT_TYPE_INT64,  {.i64 = 0}, 0, INT64_MAX, F|V },
+    {"profile"              , "record per-filter profiling data", OFFSET(profile),
+        AV_OPT_TYPE_BOOL,   {.i64 = 0}, 0, 1, F|V|A },
     { NULL },
 };
 
@@ -95,16 +105,43 @@ AVFilterGraph *avfilter_graph_alloc(void)
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&graph->frame_queues);
 
+    graph->frame_pools = ff_frame_pool_set_alloc(!CONFIG_MEMORY_POISONING);
+    if (!graph->frame_pools) {
+        av_freep(&graph);
+        return NULL;
+    }
+
     return ret;
 }
 
+static void graph_unfuse_filters(AVFilterGraph *graph)
+{
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        FFFilterContext *ctxi = fffilterctx(graph->filters[i]);
+        av_freep(&ctxi->fused);
+        ctxi->nb_fused   = 0;
+        ctxi->fused_into = NULL;
+    }
+}
+
 void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter)
 {
     int i, j;
+
+    graph_unfuse_filters(graph);
     for (i = 0; i < graph->nb_filters; i++) {
         if (graph->filters[i] == filter) {
+            FFFilterGraph *graphi = fffiltergraph(graph);
+            FFFilterContext *last = fffilterctx(graph->filters[graph->nb_filters - 1]);
+
+            graphi->ready_map[i >> 6] &= ~(1ULL << (i & 63));
+            graphi->ready_map[last->graph_index >> 6] &= ~(1ULL << (last->graph_index & 63));
             FFSWAP(AVFilterContext*, graph->filters[i],
                    graph->filters[graph->nb_filters - 1]);
+            if (&last->p != filter) {
+                last->graph_index = i;
+                ff_graph_ready_map_update(last);
+            }
             graph->nb_filters--;
             filter->graph = NULL;
             for (j = 0; j<filter->nb_outputs; j++)
@@ -129,7 +166,13 @@ void avfilter_graph_free(AVFilterGraph **graphp)
 
     ff_graph_thread_free(graphi);
 
+    if (graphi->frame_pools) {
+        ff_frame_pool_set_log_stats(graphi->frame_pools, graph, AV_LOG_VERBOSE);
+        ff_frame_pool_set_free(&graphi->frame_pools);
+    }
+
     av_freep(&graphi->sink_links);
+    av_freep(&graphi->ready_map);
 
     av_opt_free(graph);
 
@@ -188,10 +231,21 @@ AVFilterContext *avfilter_graph_alloc_filter(AVFilterGraph *graph,
         return NULL;
     graph->filters = filters;
 
+    if (graph->nb_filters >> 6 >= graphi->ready_map_size) {
+        uint64_t *ready_map = av_realloc_array(graphi->ready_map,
+                                               graphi->ready_map_size + 1,
+                                               sizeof(*ready_map));
+        if (!ready_map)
+            return NULL;
+        ready_map[graphi->ready_map_size++] = 0;
+        graphi->ready_map = ready_map;
+    }
+
     s = ff_filter_alloc(filter, name);
     if (!s)
         return NULL;
 
+    fffilterctx(s)->graph_index = graph->nb_filters;
     graph->filters[graph->nb_filters++] = s;
 
     s->graph = graph;
@@ -1356,12 +1410,98 @@ static int graph_config_pointers(AVFilterGraph *graph, void *log_ctx)
     return 0;
 }
 
+/**
+ * Check if a filter can be part of a fused chain, see FFFilter.filter_rows.
+ * @param flags AVFILTER_FUSE_* flags
+ * @return 1 if it filters the pixels, 2 if it passes the frames through
+ *         unchanged, 0 if it cannot be fused
+ */
+static int filter_is_fusable(const AVFilterContext *f, int flags)
+{
+    const FFFilter *fi = fffilter(f->filter);
+    const AVFilterLink *in, *out;
+    const AVPixFmtDescriptor *desc;
+
+    if (f->nb_inputs != 1 || f->nb_outputs != 1 || fi->activate)
+        return 0;
+    in  = f->inputs[0];
+    out = f->outputs[0];
+    if (!in || !out || in->type != AVMEDIA_TYPE_VIDEO)
+        return 0;
+
+    desc = av_pix_fmt_desc_get(in->format);
+    if (!desc || desc->flags & AV_PIX_FMT_FLAG_HWACCEL ||
+        in->format != out->format || in->w != out->w || in->h != out->h ||
+        av_cmp_q(in->time_base, out->time_base) ||
+        av_cmp_q(in->sample_aspect_ratio, out->sample_aspect_ratio))
+        return 0;
+
+    if (f->enable_str && !(f->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
+        return 0;
+
+    if (fi->rows_radius && !(flags & AVFILTER_FUSE_STRIPES))
+        return 0;
+    if (fi->filter_rows)
+        return 1;
+    return !f->input_pads[0].filter_frame ? 2 : 0;
+}
+
+/**
+ * Find the chains of filters which can be fused and set them on their first
+ * filter.
+ */
+static int graph_fuse_filters(AVFilterGraph *graph, void *log_ctx)
+{
+    graph_unfuse_filters(graph);
+    if (!graph->fuse_filters)
+        return 0;
+
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *chain[MAX_FUSED_FILTERS];
+        AVFilterContext *f = graph->filters[i];
+        FFFilterContext *ctxi = fffilterctx(f);
+        int nb_chain = 0, nb_filtering = 0, type;
+        AVBPrint bp;
+
+        // only start from the first filter of a chain
+        if (!filter_is_fusable(f, graph->fuse_filters) ||
+            filter_is_fusable(f->inputs[0]->src, graph->fuse_filters))
+            continue;
+
+        while (nb_chain < MAX_FUSED_FILTERS &&
+               (type = filter_is_fusable(f, graph->fuse_filters))) {
+            chain[nb_chain++] = f;
+            nb_filtering     += type == 1;
+            f = f->outputs[0]->dst;
+        }
+        if (nb_filtering < 2)
+            continue;
+
+        ctxi->fused = av_memdup(chain, nb_chain * sizeof(*chain));
+        if (!ctxi->fused)
+            return AVERROR(ENOMEM);
+        ctxi->nb_fused = nb_chain;
+        for (int j = 1; j < nb_chain; j++)
+            fffilterctx(chain[j])->fused_into = chain[0];
+
+        av_bprint_init(&bp, 0, AV_BPRINT_SIZE_AUTOMATIC);
+        for (int j = 0; j < nb_chain; j++)
+            av_bprintf(&bp, "%s'%s'", j ? " -> " : "", chain[j]->name);
+        av_log(log_ctx, AV_LOG_VERBOSE, "Fusing filters %s\n", bp.str);
+        av_bprint_finalize(&bp, NULL);
+    }
+
+    return 0;
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
 
     if (graphctx->max_buffered_frames)
         fffiltergraph(graphctx)->frame_queues.max_queued = graphctx->max_buffered_frames;
+    ff_frame_pool_set_max_size(fffiltergraph(graphctx)->frame_pools,
+                               graphctx->frame_pool_size);
     if ((ret = graph_check_validity(graphctx, log_ctx)))
         return ret;
     if ((ret = graph_config_formats(graphctx, log_ctx)))
@@ -1372,6 +1512,8 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = graph_fuse_filters(graphctx, log_ctx)))
+        return ret;
 
     return 0;
 }
@@ -1540,19 +1682,28 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
 
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
-    FFFilterContext *ctxi;
+    FFFilterGraph *graphi = fffiltergraph(graph);
+    FFFilterContext *ctxi = NULL;
     unsigned i;
 
     av_assert0(graph->nb_filters);
-    ctxi = fffilterctx(graph->filters[0]);
-    for (i = 1; i < graph->nb_filters; i++) {
-        FFFilterContext *ctxi_other = fffilterctx(graph->filters[i]);
-
-        if (ctxi_other->ready > ctxi->ready)
-            ctxi = ctxi_other;
+    /* Only visit the filters that are ready, the first one with the highest
+       priority wins, as when looking at all of them. */
+    for (i = 0; i < (graph->nb_filters + 63) >> 6; i++) {
+        uint64_t ready = graphi->ready_map[i];
+
+        while (ready) {
+            FFFilterContext *ctxi_other =
+                fffilterctx(graph->filters[(i << 6) + ff_ctzll(ready)]);
+
+            av_assert1(ctxi_other->ready);
+            if (!ctxi || ctxi_other->ready > ctxi->ready)
+                ctxi = ctxi_other;
+            ready &= ready - 1;
+        }
     }
 
-    if (!ctxi->ready)
+    if (!ctxi)
         return AVERROR(EAGAIN);
     return ff_filter_activate(&ctxi->p);
 }
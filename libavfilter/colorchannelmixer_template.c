@@ -50,12 +50,13 @@ static av_always_inline int fn(filter_slice_rgba_planar)(AVFilterContext *ctx, v
 {
     ColorChannelMixerContext *s = ctx->priv;
     ThreadData *td = arg;
-    AVFrame *in = td->in;
+    const AVFrame *in = td->in;
     AVFrame *out = td->out;
     const float pa = s->preserve_amount;
     const float max = (1 << depth) - 1;
-    const int slice_start = (out->height * jobnr) / nb_jobs;
-    const int slice_end = (out->height * (jobnr+1)) / nb_jobs;
+    const int h = td->y_end - td->y_start;
+    const int slice_start = td->y_start + (h * jobnr) / nb_jobs;
+    const int slice_end = td->y_start + (h * (jobnr+1)) / nb_jobs;
     const pixel *srcg = (const pixel *)(in->data[0] + slice_start * in->linesize[0]);
     const pixel *srcb = (const pixel *)(in->data[1] + slice_start * in->linesize[1]);
     const pixel *srcr = (const pixel *)(in->data[2] + slice_start * in->linesize[2]);
@@ -168,12 +169,13 @@ static av_always_inline int fn(filter_slice_rgba_packed)(AVFilterContext *ctx, v
 {
     ColorChannelMixerContext *s = ctx->priv;
     ThreadData *td = arg;
-    AVFrame *in = td->in;
+    const AVFrame *in = td->in;
     AVFrame *out = td->out;
     const float pa = s->preserve_amount;
     const float max = (1 << depth) - 1;
-    const int slice_start = (out->height * jobnr) / nb_jobs;
-    const int slice_end = (out->height * (jobnr+1)) / nb_jobs;
+    const int h = td->y_end - td->y_start;
+    const int slice_start = td->y_start + (h * jobnr) / nb_jobs;
+    const int slice_end = td->y_start + (h * (jobnr+1)) / nb_jobs;
     const uint8_t roffset = s->rgba_map[R];
     const uint8_t goffset = s->rgba_map[G];
     const uint8_t boffset = s->rgba_map[B];
@@ -50,6 +50,7 @@ typedef struct ConvolutionContext {
     int nb_threads;
     int planewidth[4];
     int planeheight[4];
+    int vsub;
     int matrix[4][49];
     int matrix_length[4];
     int copy[4];
@@ -206,6 +206,14 @@ static inline FilterLink* ff_filter_link(AVFilterLink *link)
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * Every output frame of the filter only depends on the corresponding input
+ * frame and on the filter options, not on other frames nor on their number.
+ * Separate instances of the filter can then process different frames of a
+ * stream concurrently, as done by the frameparallel filter.
+ */
+#define FF_FILTER_FLAG_FRAME_STATELESS (1 << 1)
+
 /**
  * Find the index of a link.
  *
@@ -458,6 +466,58 @@ typedef struct FFFilter {
      * activation.
      */
     int (*activate)(AVFilterContext *ctx);
+
+    /**
+     * Filter a band of rows of a video frame.
+     *
+     * May be set by filters with exactly one input and one output, whose
+     * output pixels only depend on the input pixels at the same position, and
+     * whose filter_frame() callback does nothing else than filtering the pixels
+     * of the frame and prepare_rows(). A chain of such filters may then be
+     * fused by the filtergraph: the frames are filtered band by band, every
+     * band going through all the filters of the chain while it is in cache,
+     * instead of calling filter_frame() on each of them.
+     *
+     * Different bands of the same frame may be filtered concurrently.
+     *
+     * @param in      input frame
+     * @param out     output frame, may be the same as in
+     * @param y_start first row of the band, the band starts at row
+     *                AV_CEIL_RSHIFT(y_start, log2_chroma_h) in subsampled
+     *                planes
+     * @param y_end   row following the band, the band ends before row
+     *                AV_CEIL_RSHIFT(y_end, log2_chroma_h) in subsampled planes
+     */
+    void (*filter_rows)(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                        int y_start, int y_end);
+
+    /**
+     * Prepare filtering a frame with filter_rows(), e.g. evaluate per-frame
+     * expressions. Optional.
+     *
+     * Called once per frame before filter_rows() is called on its bands, with
+     * the properties of the output frame set but not its pixels.
+     *
+     * @return >= 0 on success, a negative AVERROR code on failure
+     */
+    int (*prepare_rows)(AVFilterContext *ctx, AVFrame *out);
+
+    /**
+     * Get the number of rows above and below a band of the input that
+     * filter_rows() reads to filter that band, for filters whose output pixels
+     * depend on a neighborhood of the input pixels at the same position.
+     *
+     * Such filters are only fused with AVFILTER_FUSE_STRIPES. The frames then
+     * go through the chain in stripes: every filter of the chain is run on the
+     * rows whose neighborhood has been output by the previous filter. Their
+     * filter_rows() never filters in place and is never called concurrently.
+     *
+     * Called once per frame after prepare_rows().
+     *
+     * @return the number of rows in the unsubsampled planes, or a negative
+     *         value if filter_rows() can only filter the whole frame at once
+     */
+    int (*rows_radius)(AVFilterContext *ctx);
 } FFFilter;
 
 static inline const FFFilter *fffilter(const AVFilter *f)
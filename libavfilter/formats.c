@@ -91,10 +91,18 @@ do {                                                                       \
     MERGE_REF(a, b, fmts, type, return AVERROR(ENOMEM););                  \
 } while (0)
 
+/**
+ * Maximum value + 1 of the pixel and sample formats, for the bitmaps of
+ * merge_formats_internal().
+ */
+#define MAX_FORMATS FFMAX((int)AV_PIX_FMT_NB, (int)AV_SAMPLE_FMT_NB)
+
 static int merge_formats_internal(AVFilterFormats *a, AVFilterFormats *b,
                                   enum AVMediaType type, int check)
 {
-    int i, j;
+    uint64_t in_b[(MAX_FORMATS + 63) / 64] = { 0 };
+    const int nb_max = type == AVMEDIA_TYPE_VIDEO ? AV_PIX_FMT_NB : AV_SAMPLE_FMT_NB;
+    int i, k = 0;
     int alpha1=0, alpha2=0;
     int chroma1=0, chroma2=0;
 
@@ -103,6 +111,15 @@ static int merge_formats_internal(AVFilterFormats *a, AVFilterFormats *b,
     if (a == b)
         return 1;
 
+    /* Look the formats of b up in a bitmap rather than searching them for
+       each format of a, the lists may hold hundreds of formats. */
+    for (i = 0; i < b->nb_formats; i++) {
+        const unsigned fmt = b->formats[i];
+        av_assert1(fmt < nb_max);
+        if (fmt < nb_max)
+            in_b[fmt >> 6] |= 1ULL << (fmt & 63);
+    }
+
     /* Do not lose chroma or alpha in merging.
        It happens if both lists have formats with chroma (resp. alpha), but
        the only formats in common do not have it (e.g. YUV+gray vs.
@@ -110,25 +127,51 @@ static int merge_formats_internal(AVFilterFormats *a, AVFilterFormats *b,
        possibly causing a lossy conversion elsewhere in the graph.
        To avoid that, pretend that there are no common formats to force the
        insertion of a conversion filter. */
-    if (type == AVMEDIA_TYPE_VIDEO)
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        int alpha_a = 0, alpha_b = 0, chroma_a = 0, chroma_b = 0;
+
         for (i = 0; i < a->nb_formats; i++) {
-            const AVPixFmtDescriptor *const adesc = av_pix_fmt_desc_get(a->formats[i]);
-            for (j = 0; j < b->nb_formats; j++) {
-                const AVPixFmtDescriptor *bdesc = av_pix_fmt_desc_get(b->formats[j]);
-                alpha2 |= adesc->flags & bdesc->flags & AV_PIX_FMT_FLAG_ALPHA;
-                chroma2|= adesc->nb_components > 1 && bdesc->nb_components > 1;
-                if (a->formats[i] == b->formats[j]) {
-                    alpha1 |= adesc->flags & AV_PIX_FMT_FLAG_ALPHA;
-                    chroma1|= adesc->nb_components > 1;
-                }
+            const AVPixFmtDescriptor *const desc = av_pix_fmt_desc_get(a->formats[i]);
+            const int alpha  = desc->flags & AV_PIX_FMT_FLAG_ALPHA;
+            const int chroma = desc->nb_components > 1;
+            const unsigned fmt = a->formats[i];
+
+            alpha_a  |= alpha;
+            chroma_a |= chroma;
+            if (fmt < nb_max && in_b[fmt >> 6] & (1ULL << (fmt & 63))) {
+                alpha1  |= alpha;
+                chroma1 |= chroma;
             }
         }
+        for (i = 0; i < b->nb_formats; i++) {
+            const AVPixFmtDescriptor *const desc = av_pix_fmt_desc_get(b->formats[i]);
+            alpha_b  |= desc->flags & AV_PIX_FMT_FLAG_ALPHA;
+            chroma_b |= desc->nb_components > 1;
+        }
+        alpha2  = alpha_a & alpha_b;
+        chroma2 = chroma_a && chroma_b;
+    }
 
     // If chroma or alpha can be lost through merging then do not merge
     if (alpha2 > alpha1 || chroma2 > chroma1)
         return 0;
 
-    MERGE_FORMATS(a, b, formats, nb_formats, AVFilterFormats, check, 0);
+    for (i = 0; i < a->nb_formats; i++) {
+        const unsigned fmt = a->formats[i];
+        if (fmt < nb_max && in_b[fmt >> 6] & (1ULL << (fmt & 63))) {
+            if (check)
+                return 1;
+            a->formats[k++] = a->formats[i];
+        }
+    }
+    /* Check that there was at least one common format.
+     * Notice that both a and b are unchanged if not. */
+    if (!k)
+        return 0;
+    av_assert2(!check);
+    a->nb_formats = k;
+
+    MERGE_REF(a, b, formats, AVFilterFormats, return AVERROR(ENOMEM););
 
     return 1;
 }
@@ -1083,8 +1126,14 @@ int ff_default_query_formats(AVFilterContext *ctx)
     return 0;
 }
 
-static int check_list(void *log, const char *name, const AVFilterFormats *fmts)
+/**
+ * @param nb_max if not 0, the formats below it are checked for duplicates
+ *               with a bitmap, it must not be more than MAX_FORMATS
+ */
+static int check_list(void *log, const char *name, const AVFilterFormats *fmts,
+                      unsigned nb_max)
 {
+    uint64_t seen[(MAX_FORMATS + 63) / 64] = { 0 };
     unsigned i, j;
 
     if (!fmts)
@@ -1094,31 +1143,41 @@ static int check_list(void *log, const char *name, const AVFilterFormats *fmts)
         return AVERROR(EINVAL);
     }
     for (i = 0; i < fmts->nb_formats; i++) {
+        const unsigned fmt = fmts->formats[i];
+
+        if (fmt < nb_max) {
+            if (seen[fmt >> 6] & (1ULL << (fmt & 63)))
+                goto duplicated;
+            seen[fmt >> 6] |= 1ULL << (fmt & 63);
+            continue;
+        }
         for (j = i + 1; j < fmts->nb_formats; j++) {
-            if (fmts->formats[i] == fmts->formats[j]) {
-                av_log(log, AV_LOG_ERROR, "Duplicated %s\n", name);
-                return AVERROR(EINVAL);
-            }
+            if (fmts->formats[i] == fmts->formats[j])
+                goto duplicated;
         }
     }
     return 0;
+
+duplicated:
+    av_log(log, AV_LOG_ERROR, "Duplicated %s\n", name);
+    return AVERROR(EINVAL);
 }
 
 int ff_formats_check_pixel_formats(void *log, const AVFilterFormats *fmts)
 {
-    return check_list(log, "pixel format", fmts);
+    return check_list(log, "pixel format", fmts, AV_PIX_FMT_NB);
 }
 
 int ff_formats_check_sample_formats(void *log, const AVFilterFormats *fmts)
 {
-    return check_list(log, "sample format", fmts);
+    return check_list(log, "sample format", fmts, AV_SAMPLE_FMT_NB);
 }
 
 int ff_formats_check_sample_rates(void *log, const AVFilterFormats *fmts)
 {
     if (!fmts || !fmts->nb_formats)
         return 0;
-    return check_list(log, "sample rate", fmts);
+    return check_list(log, "sample rate", fmts, 0);
 }
 
 int ff_formats_check_color_spaces(void *log, const AVFilterFormats *fmts)
@@ -1129,12 +1188,12 @@ int ff_formats_check_color_spaces(void *log, const AVFilterFormats *fmts)
             return AVERROR(EINVAL);
         }
     }
-    return check_list(log, "color space", fmts);
+    return check_list(log, "color space", fmts, 0);
 }
 
 int ff_formats_check_color_ranges(void *log, const AVFilterFormats *fmts)
 {
-    return check_list(log, "color range", fmts);
+    return check_list(log, "color range", fmts, 0);
 }
 
 static int layouts_compatible(const AVChannelLayout *a, const AVChannelLayout *b)
@@ -18,6 +18,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <inttypes.h>
+#include <stdatomic.h>
+
 #include "framepool.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
@@ -27,6 +30,8 @@
 #include "libavutil/imgutils_internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/refstruct.h"
+#include "libavutil/thread.h"
 
 struct FFFramePool {
 
@@ -49,11 +54,13 @@ struct FFFramePool {
 
 };
 
-FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
-                                      int width,
-                                      int height,
-                                      enum AVPixelFormat format,
-                                      int align)
+static FFFramePool *frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
+                                          AVBufferRef* (*alloc2)(void *opaque, size_t size),
+                                          void *opaque,
+                                          int width,
+                                          int height,
+                                          enum AVPixelFormat format,
+                                          int align)
 {
     int i, ret;
     FFFramePool *pool;
@@ -100,7 +107,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
     for (i = 0; i < 4 && sizes[i]; i++) {
         if (sizes[i] > SIZE_MAX - align)
             goto fail;
-        pool->pools[i] = av_buffer_pool_init(sizes[i] + align, alloc);
+        pool->pools[i] = alloc2 ? av_buffer_pool_init2(sizes[i] + align, opaque, alloc2, NULL) :
+                                  av_buffer_pool_init(sizes[i] + align, alloc);
         if (!pool->pools[i])
             goto fail;
     }
@@ -112,6 +120,15 @@ fail:
     return NULL;
 }
 
+FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
+                                      int width,
+                                      int height,
+                                      enum AVPixelFormat format,
+                                      int align)
+{
+    return frame_pool_video_init(alloc, NULL, NULL, width, height, format, align);
+}
+
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
                                       int channels,
                                       int nb_samples,
@@ -293,3 +310,222 @@ void ff_frame_pool_uninit(FFFramePool **pool)
 
     av_freep(pool);
 }
+
+/**
+ * Number of frames allocated from a set after which a pool of the set which
+ * was not used to allocate any of them is released.
+ */
+#define POOL_SET_COLD_AGE 1024
+
+/**
+ * Number of bytes allocated by the pools of a set. Referenced by every buffer
+ * allocated by them, as they may outlive the set.
+ */
+typedef struct PoolSetUsage {
+    atomic_uint_least64_t bytes;
+} PoolSetUsage;
+
+typedef struct PoolSetBuffer {
+    PoolSetUsage *usage;
+    size_t        size;
+} PoolSetBuffer;
+
+typedef struct PoolSetEntry {
+    FFFramePool *pool;
+    uint64_t     last_used;
+} PoolSetEntry;
+
+struct FFFramePoolSet {
+    AVMutex lock;
+
+    PoolSetEntry *entries;
+    int        nb_entries;
+
+    int zero;
+    int64_t max_size;
+    PoolSetUsage *usage;
+
+    /* statistics, protected by lock */
+    uint64_t nb_frames;
+    uint64_t nb_allocs;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t released;
+    uint64_t peak_bytes;
+};
+
+FFFramePoolSet *ff_frame_pool_set_alloc(int zero)
+{
+    FFFramePoolSet *set = av_mallocz(sizeof(*set));
+
+    if (!set)
+        return NULL;
+
+    set->usage = av_refstruct_allocz(sizeof(*set->usage));
+    if (!set->usage || ff_mutex_init(&set->lock, NULL)) {
+        av_refstruct_unref(&set->usage);
+        av_freep(&set);
+        return NULL;
+    }
+    atomic_init(&set->usage->bytes, 0);
+    set->zero = zero;
+
+    return set;
+}
+
+void ff_frame_pool_set_max_size(FFFramePoolSet *set, int64_t max_size)
+{
+    ff_mutex_lock(&set->lock);
+    set->max_size = max_size;
+    ff_mutex_unlock(&set->lock);
+}
+
+static void pool_set_buffer_free(void *opaque, uint8_t *data)
+{
+    PoolSetBuffer *buf = opaque;
+
+    atomic_fetch_sub_explicit(&buf->usage->bytes, buf->size, memory_order_relaxed);
+    av_refstruct_unref(&buf->usage);
+    av_free(buf);
+    av_free(data);
+}
+
+/* Called by av_buffer_pool_get() with the lock of the set held. */
+static AVBufferRef *pool_set_buffer_alloc(void *opaque, size_t size)
+{
+    FFFramePoolSet *set = opaque;
+    PoolSetBuffer *buf = av_mallocz(sizeof(*buf));
+    uint8_t *data = set->zero ? av_mallocz(size) : av_malloc(size);
+    AVBufferRef *ref = NULL;
+    uint64_t bytes;
+
+    if (buf && data)
+        ref = av_buffer_create(data, size, pool_set_buffer_free, buf, 0);
+    if (!ref) {
+        av_free(buf);
+        av_free(data);
+        return NULL;
+    }
+
+    buf->usage = av_refstruct_ref(set->usage);
+    buf->size  = size;
+    bytes = atomic_fetch_add_explicit(&set->usage->bytes, size,
+                                      memory_order_relaxed) + size;
+    set->peak_bytes = FFMAX(set->peak_bytes, bytes);
+    set->nb_allocs++;
+
+    return ref;
+}
+
+static void pool_set_release(FFFramePoolSet *set, int idx)
+{
+    ff_frame_pool_uninit(&set->entries[idx].pool);
+    set->entries[idx] = set->entries[--set->nb_entries];
+    set->released++;
+}
+
+/**
+ * Release the pools which were not used recently, then the least recently
+ * used ones while the set is over its maximum size. The buffers in use are
+ * freed when they are unreferenced.
+ */
+static void pool_set_trim(FFFramePoolSet *set, const FFFramePool *keep)
+{
+    for (int i = set->nb_entries - 1; i >= 0; i--)
+        if (set->entries[i].pool != keep &&
+            set->nb_frames - set->entries[i].last_used > POOL_SET_COLD_AGE)
+            pool_set_release(set, i);
+
+    while (set->max_size &&
+           atomic_load_explicit(&set->usage->bytes, memory_order_relaxed) > set->max_size) {
+        int lru = -1;
+
+        for (int i = 0; i < set->nb_entries; i++)
+            if (set->entries[i].pool != keep &&
+                (lru < 0 || set->entries[i].last_used < set->entries[lru].last_used))
+                lru = i;
+        if (lru < 0)
+            break;
+        pool_set_release(set, lru);
+    }
+}
+
+AVFrame *ff_frame_pool_set_get_video(FFFramePoolSet *set,
+                                     int width,
+                                     int height,
+                                     enum AVPixelFormat format,
+                                     int align)
+{
+    PoolSetEntry *entry = NULL;
+    FFFramePool *pool;
+    AVFrame *frame = NULL;
+    uint64_t nb_allocs;
+
+    ff_mutex_lock(&set->lock);
+
+    for (int i = 0; i < set->nb_entries; i++) {
+        pool = set->entries[i].pool;
+        if (pool->width == width && pool->height == height &&
+            pool->format == format && pool->align == align) {
+            entry = &set->entries[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        PoolSetEntry *entries = av_realloc_array(set->entries, set->nb_entries + 1,
+                                                 sizeof(*entries));
+        if (!entries)
+            goto end;
+        set->entries = entries;
+
+        pool = frame_pool_video_init(NULL, pool_set_buffer_alloc, set,
+                                     width, height, format, align);
+        if (!pool)
+            goto end;
+        entry = &set->entries[set->nb_entries++];
+        entry->pool = pool;
+    }
+    entry->last_used = ++set->nb_frames;
+
+    nb_allocs = set->nb_allocs;
+    frame = ff_frame_pool_get(pool);
+    if (!frame)
+        goto end;
+
+    if (set->nb_allocs == nb_allocs)
+        set->hits++;
+    else
+        set->misses++;
+    if (set->nb_allocs != nb_allocs || !(set->nb_frames % POOL_SET_COLD_AGE))
+        pool_set_trim(set, pool);
+
+end:
+    ff_mutex_unlock(&set->lock);
+    return frame;
+}
+
+void ff_frame_pool_set_log_stats(FFFramePoolSet *set, void *log_ctx, int level)
+{
+    ff_mutex_lock(&set->lock);
+    if (set->hits || set->misses)
+        av_log(log_ctx, level, "Frame pools: %"PRIu64" hits, %"PRIu64" misses, "
+               "%"PRIu64" bytes peak, %"PRIu64" pools released\n",
+               set->hits, set->misses, set->peak_bytes, set->released);
+    ff_mutex_unlock(&set->lock);
+}
+
+void ff_frame_pool_set_free(FFFramePoolSet **pset)
+{
+    FFFramePoolSet *set = *pset;
+
+    if (!set)
+        return;
+
+    for (int i = 0; i < set->nb_entries; i++)
+        ff_frame_pool_uninit(&set->entries[i].pool);
+    av_freep(&set->entries);
+    av_refstruct_unref(&set->usage);
+    ff_mutex_destroy(&set->lock);
+    av_freep(pset);
+}
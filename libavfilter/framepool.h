@@ -115,5 +115,58 @@ int ff_frame_pool_get_audio_config(FFFramePool *pool,
  */
 AVFrame *ff_frame_pool_get(FFFramePool *pool);
 
+/**
+ * Set of video frame pools, one for each frame configuration, shared by all
+ * the links of a filtergraph. This structure is opaque and not meant to be
+ * accessed directly. It is allocated with ff_frame_pool_set_alloc() and freed
+ * with ff_frame_pool_set_free().
+ *
+ * Pools which have not been used for a while are released, as are the least
+ * recently used ones when the buffers allocated by the set exceed its maximum
+ * size.
+ */
+typedef struct FFFramePoolSet FFFramePoolSet;
+
+/**
+ * Allocate a set of video frame pools.
+ *
+ * @param zero if set, the buffers are zeroed when they are allocated
+ * @return newly created set on success, NULL on error.
+ */
+FFFramePoolSet *ff_frame_pool_set_alloc(int zero);
+
+/**
+ * Set the number of bytes which the buffers allocated by the pools of the set,
+ * in use or not, should not exceed. 0 means no limit, which is the default.
+ */
+void ff_frame_pool_set_max_size(FFFramePoolSet *set, int64_t max_size);
+
+/**
+ * Allocate a new video frame from the pool of the set with the given
+ * configuration, creating that pool if needed.
+ * This function may be called simultaneously from multiple threads.
+ *
+ * @return a new AVFrame on success, NULL on error.
+ */
+AVFrame *ff_frame_pool_set_get_video(FFFramePoolSet *set,
+                                     int width,
+                                     int height,
+                                     enum AVPixelFormat format,
+                                     int align);
+
+/**
+ * Log the statistics of the set: the frames allocated with and without
+ * allocating new buffers, the peak number of bytes allocated and the number
+ * of pools released.
+ */
+void ff_frame_pool_set_log_stats(FFFramePoolSet *set, void *log_ctx, int level);
+
+/**
+ * Free the set and its pools. It is safe to call this function while some of
+ * the allocated frames are still in use.
+ *
+ * @param set pointer to the set to be freed. It will be set to NULL.
+ */
+void ff_frame_pool_set_free(FFFramePoolSet **set);
 
 #endif /* AVFILTER_FRAMEPOOL_H */
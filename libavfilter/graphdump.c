@@ -19,13 +19,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <inttypes.h>
 #include <string.h>
 
+#include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/bprint.h"
+#include "libavutil/internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
+#include "avfilter_internal.h"
 #include "filters.h"
 
 static int print_link_prop(AVBPrint *buf, AVFilterLink *link)
@@ -167,3 +171,160 @@ char *avfilter_graph_dump(AVFilterGraph *graph, const char *options)
     avfilter_graph_dump_to_buf(&buf, graph);
     return dump;
 }
+
+static void filter_frame_counts(AVFilterContext *filter,
+                                uint64_t *frames_in, uint64_t *frames_out)
+{
+    *frames_in = *frames_out = 0;
+    for (unsigned i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i])
+            *frames_in += ff_filter_link(filter->inputs[i])->frame_count_out;
+    for (unsigned i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i])
+            *frames_out += ff_filter_link(filter->outputs[i])->frame_count_in;
+}
+
+static void json_string(AVBPrint *buf, const char *str)
+{
+    av_bprint_chars(buf, '"', 1);
+    for (const uint8_t *p = (const uint8_t *)(str ? str : ""); *p; p++) {
+        switch (*p) {
+        case '"':  av_bprintf(buf, "\\\""); break;
+        case '\\': av_bprintf(buf, "\\\\"); break;
+        case '\b': av_bprintf(buf, "\\b");  break;
+        case '\f': av_bprintf(buf, "\\f");  break;
+        case '\n': av_bprintf(buf, "\\n");  break;
+        case '\r': av_bprintf(buf, "\\r");  break;
+        case '\t': av_bprintf(buf, "\\t");  break;
+        default:
+            if (*p < 0x20)
+                av_bprintf(buf, "\\u%04x", *p);
+            else
+                av_bprint_chars(buf, *p, 1);
+        }
+    }
+    av_bprint_chars(buf, '"', 1);
+}
+
+static void dump_profile_json(AVBPrint *buf, AVFilterGraph *graph)
+{
+    av_bprintf(buf, "{\n    \"filters\": [");
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        FFFilterContext *ctxi = fffilterctx(filter);
+        uint64_t frames_in, frames_out;
+
+        filter_frame_counts(filter, &frames_in, &frames_out);
+        av_bprintf(buf, "%s\n        {\n            \"name\": ", i ? "," : "");
+        json_string(buf, filter->name);
+        av_bprintf(buf, ",\n            \"filter\": ");
+        json_string(buf, filter->filter->name);
+        if (ctxi->fused_into) {
+            av_bprintf(buf, ",\n            \"fused_into\": ");
+            json_string(buf, ctxi->fused_into->name);
+        }
+        av_bprintf(buf, ",\n"
+                   "            \"activations\": %"PRIu64",\n"
+                   "            \"wall_time_ns\": %"PRId64",\n"
+                   "            \"cpu_time_ns\": %"PRId64",\n"
+                   "            \"frames_in\": %"PRIu64",\n"
+                   "            \"frames_out\": %"PRIu64",\n"
+                   "            \"alloc_bytes\": %"PRIu64",\n"
+                   "            \"copies\": %"PRIu64",\n"
+                   "            \"outputs\": [",
+                   ctxi->prof_activations, ctxi->prof_wall_time,
+                   ctxi->prof_cpu_time, frames_in, frames_out,
+                   ctxi->prof_alloc_bytes, ctxi->prof_copies);
+        for (unsigned j = 0; j < filter->nb_outputs; j++) {
+            AVFilterLink *link = filter->outputs[j];
+            FilterLinkInternal *li;
+
+            if (!link)
+                continue;
+            li = ff_link_internal(link);
+            av_bprintf(buf, "%s\n                { \"pad\": ", j ? "," : "");
+            json_string(buf, link->srcpad->name);
+            av_bprintf(buf, ", \"dst\": ");
+            json_string(buf, link->dst->name);
+            av_bprintf(buf, ", \"dst_pad\": ");
+            json_string(buf, link->dstpad->name);
+            av_bprintf(buf, ", \"frames\": %"PRId64", \"queued\": %"SIZE_SPECIFIER
+                       ", \"max_queued\": %"SIZE_SPECIFIER" }",
+                       li->l.frame_count_in, ff_framequeue_queued_frames(&li->fifo),
+                       li->max_queued);
+        }
+        av_bprintf(buf, "%s]\n        }", filter->nb_outputs ? "\n            " : "");
+    }
+    av_bprintf(buf, "\n    ]\n}\n");
+}
+
+static void dump_profile_text(AVBPrint *buf, AVFilterGraph *graph)
+{
+    int width = strlen("filter");
+
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        width = FFMAX(width, strlen(filter->name) + strlen(filter->filter->name) + 3);
+    }
+
+    av_bprintf(buf, "%-*s %12s %12s %12s %10s %10s %12s %8s\n", width, "filter",
+               "activations", "wall ms", "cpu ms", "frames in", "frames out",
+               "alloc MiB", "copies");
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        FFFilterContext *ctxi = fffilterctx(filter);
+        uint64_t frames_in, frames_out;
+        int len = strlen(filter->name) + strlen(filter->filter->name) + 3;
+
+        filter_frame_counts(filter, &frames_in, &frames_out);
+        // fused filters run within the first filter of their chain
+        if (ctxi->fused_into)
+            av_bprintf(buf, "%s (%s)%*s %12s %12s %12s %10"PRIu64" %10"PRIu64" %12s %8s fused into %s\n",
+                       filter->name, filter->filter->name, width - len, "",
+                       "-", "-", "-", frames_in, frames_out, "-", "-",
+                       ctxi->fused_into->name);
+        else
+            av_bprintf(buf, "%s (%s)%*s %12"PRIu64" %12.3f %12.3f %10"PRIu64" %10"PRIu64" %12.3f %8"PRIu64"\n",
+                       filter->name, filter->filter->name, width - len, "",
+                       ctxi->prof_activations, ctxi->prof_wall_time / 1e6,
+                       ctxi->prof_cpu_time / 1e6, frames_in, frames_out,
+                       ctxi->prof_alloc_bytes / (1024.0 * 1024.0), ctxi->prof_copies);
+        for (unsigned j = 0; j < filter->nb_outputs; j++) {
+            AVFilterLink *link = filter->outputs[j];
+            FilterLinkInternal *li;
+
+            if (!link)
+                continue;
+            li = ff_link_internal(link);
+            av_bprintf(buf, "    %s -> %s:%s: %"PRId64" frames, %"SIZE_SPECIFIER
+                       " queued, at most %"SIZE_SPECIFIER"\n",
+                       link->srcpad->name, link->dst->name, link->dstpad->name,
+                       li->l.frame_count_in, ff_framequeue_queued_frames(&li->fifo),
+                       li->max_queued);
+        }
+    }
+}
+
+int avfilter_graph_dump_profile(AVFilterGraph *graph, const char *format,
+                                char **dump)
+{
+    AVBPrint buf;
+    int json;
+
+    *dump = NULL;
+
+    if (!format || !strcmp(format, "text"))
+        json = 0;
+    else if (!strcmp(format, "json"))
+        json = 1;
+    else
+        return AVERROR(EINVAL);
+
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+    if (json)
+        dump_profile_json(&buf, graph);
+    else
+        dump_profile_text(&buf, graph);
+
+    return av_bprint_finalize(&buf, dump);
+}
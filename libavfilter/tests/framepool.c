@@ -0,0 +1,80 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavfilter/framepool.c"
+
+static void print_set(const FFFramePoolSet *set, const char *step)
+{
+    printf("%-32s pools:%d hits:%"PRIu64" misses:%"PRIu64" released:%"PRIu64"\n",
+           step, set->nb_entries, set->hits, set->misses, set->released);
+}
+
+/* get a frame and unreference it at once, returning its buffers to the pool */
+static int get_unref(FFFramePoolSet *set, int w, int h, int align)
+{
+    AVFrame *frame = ff_frame_pool_set_get_video(set, w, h, AV_PIX_FMT_YUV420P, align);
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+    av_frame_free(&frame);
+    return 0;
+}
+
+int main(void)
+{
+    AVFrame *frames[3] = { NULL };
+    FFFramePoolSet *set;
+    int ret = 0;
+
+    /* the pools are shared by the frames of the same configuration */
+    set = ff_frame_pool_set_alloc(0);
+    if (!set)
+        return 1;
+    for (int i = 0; i < 4; i++)
+        ret |= get_unref(set, 64, 32, 32);
+    print_set(set, "same configuration");
+    ret |= get_unref(set, 64, 32, 64);
+    ret |= get_unref(set, 32, 64, 32);
+    print_set(set, "other alignment and size");
+
+    /* the pools not used for POOL_SET_COLD_AGE frames are released */
+    for (int i = 0; i < 2 * POOL_SET_COLD_AGE; i++)
+        ret |= get_unref(set, 64, 32, 32);
+    print_set(set, "cold pools");
+    ff_frame_pool_set_free(&set);
+
+    /* over the maximum size, the other pools are released but the frames are
+       still allocated */
+    set = ff_frame_pool_set_alloc(0);
+    if (!set)
+        return 1;
+    ff_frame_pool_set_max_size(set, 1);
+    frames[0] = ff_frame_pool_set_get_video(set, 64, 32, AV_PIX_FMT_YUV420P, 32);
+    frames[1] = ff_frame_pool_set_get_video(set, 32, 64, AV_PIX_FMT_YUV420P, 32);
+    frames[2] = ff_frame_pool_set_get_video(set, 32, 64, AV_PIX_FMT_YUV420P, 32);
+    printf("over maximum size: frames %s %s %s\n", frames[0] ? "ok" : "failed",
+           frames[1] ? "ok" : "failed", frames[2] ? "ok" : "failed");
+    print_set(set, "over maximum size");
+    for (int i = 0; i < FF_ARRAY_ELEMS(frames); i++)
+        av_frame_free(&frames[i]);
+    ff_frame_pool_set_free(&set);
+
+    return !!ret;
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/error.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/avfilter_internal.h"
+#include "libavfilter/filters.h"
+
+/* print the filters of the graph and the ready bits, which must match */
+static void print_ready(AVFilterGraph *graph, const char *step)
+{
+    FFFilterGraph *graphi = fffiltergraph(graph);
+    int ok = 1, any_ready = 0;
+
+    printf("%-24s", step);
+    for (unsigned i = 0; i < graph->nb_filters; i++)
+        printf(" %s:%u", graph->filters[i]->name,
+               fffilterctx(graph->filters[i])->ready);
+    for (unsigned i = 0; i < graphi->ready_map_size * 64; i++) {
+        int bit   = graphi->ready_map[i >> 6] >> (i & 63) & 1;
+        int ready = i < graph->nb_filters && fffilterctx(graph->filters[i])->ready;
+
+        if (bit != ready)
+            ok = 0;
+        any_ready |= bit;
+    }
+    printf(" -> %s", ok ? "ok" : "MISMATCH");
+    /* with nothing ready, running the graph must not touch any filter */
+    if (!any_ready)
+        printf(", run_once: %s", ff_filter_graph_run_once(graph) == AVERROR(EAGAIN) ?
+                                 "EAGAIN" : "other");
+    printf("\n");
+}
+
+int main(void)
+{
+    const AVFilter *null = avfilter_get_by_name("null");
+    AVFilterContext *f[4];
+    AVFilterGraph *graph;
+
+    graph = avfilter_graph_alloc();
+    if (!graph)
+        return 1;
+
+    for (int i = 0; i < 3; i++) {
+        char name[8];
+
+        snprintf(name, sizeof(name), "f%d", i);
+        if (!(f[i] = avfilter_graph_alloc_filter(graph, null, name)))
+            return 1;
+    }
+    print_ready(graph, "initial");
+
+    /* remove the last filter while it is ready */
+    ff_filter_set_ready(f[2], 100);
+    print_ready(graph, "f2 ready");
+    avfilter_free(f[2]);
+    print_ready(graph, "f2 removed");
+
+    /* a new filter reuses the index and must not inherit the bit */
+    if (!(f[3] = avfilter_graph_alloc_filter(graph, null, "f3")))
+        return 1;
+    print_ready(graph, "f3 added");
+
+    /* remove a filter in the middle, the last one moves to its place */
+    ff_filter_set_ready(f[3], 100);
+    avfilter_free(f[0]);
+    print_ready(graph, "f0 removed");
+    avfilter_free(f[3]);
+    print_ready(graph, "f3 removed");
+
+    avfilter_graph_free(&graph);
+    return 0;
+}
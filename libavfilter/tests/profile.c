@@ -0,0 +1,127 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/avfilter_internal.h"
+
+static const struct {
+    const char *filter, *name, *args;
+} chain[] = {
+    { "color",     "src",                 "s=32x16:r=10:d=0.5"                        },
+    /* passes buffer requests through to the next filter */
+    { "transpose", "transpose",           "dir=clock:passthrough=landscape"           },
+    /* fused with the next filter */
+    { "eq",        "eq",                  "contrast=1.5"                              },
+    /* with characters to escape in its name */
+    { "negate",    "neg\"a\\b\tc\x01",    NULL                                        },
+    { "nullsink",  "sink",                NULL                                        },
+};
+
+/* print a dump with the numbers, which vary with timing and the CPU, masked,
+   and the control characters of the filter names escaped */
+static void print_masked(const char *dump)
+{
+    for (const char *p = dump; *p; p++) {
+        if (p[0] == '\\' && p[1] == 'u' && strlen(p) >= 6) {
+            printf("%.6s", p);
+            p += 5;
+        } else if ((*p >= '0' && *p <= '9') || (*p == '.' && p[1] >= '0' && p[1] <= '9')) {
+            while ((p[1] >= '0' && p[1] <= '9') || p[1] == '.')
+                p++;
+            putchar('#');
+        } else if (*p == ' ') {
+            while (p[1] == ' ')
+                p++;
+            putchar(' ');
+        } else if ((unsigned char)*p < 0x20 && *p != '\n') {
+            printf("\\x%02x", *p);
+        } else
+            putchar(*p);
+    }
+}
+
+int main(void)
+{
+    AVFilterContext *f[FF_ARRAY_ELEMS(chain)];
+    AVFilterGraph *graph;
+    char *dump;
+    int ret;
+
+    graph = avfilter_graph_alloc();
+    if (!graph)
+        return 1;
+    graph->profile = 1;
+    graph->nb_threads = 1;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(chain); i++) {
+        ret = avfilter_graph_create_filter(&f[i], avfilter_get_by_name(chain[i].filter),
+                                           chain[i].name, chain[i].args, NULL, graph);
+        if (ret < 0)
+            goto fail;
+        if (i && (ret = avfilter_link(f[i - 1], 0, f[i], 0)) < 0)
+            goto fail;
+    }
+    ret = avfilter_graph_config(graph, NULL);
+    if (ret < 0)
+        goto fail;
+
+    do {
+        ret = avfilter_graph_request_oldest(graph);
+    } while (ret >= 0 || ret == AVERROR(EAGAIN));
+    if (ret != AVERROR_EOF)
+        goto fail;
+
+    /* buffers are accounted to the filter which requested them, fused
+       filters to the first filter of their chain */
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        FFFilterContext *ctxi = fffilterctx(graph->filters[i]);
+
+        printf("%s: allocated %s, fused into %s\n",
+               graph->filters[i]->filter->name,
+               ctxi->prof_alloc_bytes ? "yes" : "no",
+               ctxi->fused_into ? ctxi->fused_into->filter->name : "none");
+    }
+
+    ret = avfilter_graph_dump_profile(graph, "text", &dump);
+    if (ret < 0)
+        goto fail;
+    print_masked(dump);
+    av_free(dump);
+
+    ret = avfilter_graph_dump_profile(graph, "json", &dump);
+    if (ret < 0)
+        goto fail;
+    print_masked(dump);
+    av_free(dump);
+
+    ret = avfilter_graph_dump_profile(graph, "xml", &dump);
+    printf("xml: %s, %s\n", av_err2str(ret), dump ? "dump" : "no dump");
+
+    avfilter_graph_free(&graph);
+    return 0;
+
+fail:
+    printf("error: %s\n", av_err2str(ret));
+    avfilter_graph_free(&graph);
+    return 1;
+}
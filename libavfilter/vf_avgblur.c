@@ -340,6 +340,7 @@ const FFFilter ff_vf_avgblur = {
     .p.priv_class  = &avgblur_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
     .priv_size     = sizeof(AverageBlurContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     .uninit        = uninit,
     FILTER_INPUTS(avgblur_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
@@ -303,6 +303,7 @@ const FFFilter ff_vf_boxblur = {
     .p.priv_class  = &boxblur_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
     .priv_size     = sizeof(BoxBlurContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     .uninit        = uninit,
     FILTER_INPUTS(avfilter_vf_boxblur_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
@@ -436,6 +436,7 @@ const FFFilter ff_vf_colorbalance = {
     .p.priv_class  = &colorbalance_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ColorBalanceContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(colorbalance_inputs),
     FILTER_OUTPUTS(colorbalance_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
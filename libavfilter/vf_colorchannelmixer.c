@@ -35,7 +35,9 @@
 #define A 3
 
 typedef struct ThreadData {
-    AVFrame *in, *out;
+    const AVFrame *in;
+    AVFrame *out;
+    int y_start, y_end;
 } ThreadData;
 
 typedef struct ColorChannelMixerContext {
@@ -429,6 +431,15 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
+static void filter_rows(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                        int y_start, int y_end)
+{
+    ColorChannelMixerContext *s = ctx->priv;
+    ThreadData td = { .in = in, .out = out, .y_start = y_start, .y_end = y_end };
+
+    s->filter_slice[s->preserve_color > 0](ctx, &td, 0, 1);
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -451,6 +462,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 
     td.in = in;
     td.out = out;
+    td.y_start = 0;
+    td.y_end = out->height;
     ff_filter_execute(ctx, s->filter_slice[pc], &td, NULL,
                       FFMIN(outlink->h, ff_filter_get_nb_threads(ctx)));
 
@@ -499,9 +512,11 @@ const FFFilter ff_vf_colorchannelmixer = {
     .p.priv_class  = &colorchannelmixer_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ColorChannelMixerContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     .uninit        = uninit,
     FILTER_INPUTS(colorchannelmixer_inputs),
     FILTER_OUTPUTS(colorchannelmixer_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .process_command = process_command,
+    .filter_rows     = filter_rows,
 };
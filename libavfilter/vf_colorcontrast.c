@@ -380,6 +380,7 @@ const FFFilter ff_vf_colorcontrast = {
     .p.priv_class  = &colorcontrast_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ColorContrastContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(colorcontrast_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pixel_fmts),
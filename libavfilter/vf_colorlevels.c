@@ -563,6 +563,7 @@ const FFFilter ff_vf_colorlevels = {
     .p.priv_class  = &colorlevels_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ColorLevelsContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(colorlevels_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS(AV_PIX_FMT_0RGB,   AV_PIX_FMT_0BGR,
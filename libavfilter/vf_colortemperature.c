@@ -386,6 +386,7 @@ const FFFilter ff_vf_colortemperature = {
     .p.priv_class  = &colortemperature_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ColorTemperatureContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pixel_fmts),
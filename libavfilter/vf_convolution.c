@@ -574,79 +574,120 @@ static void setup_column(int radius, const uint8_t *c[], const uint8_t *src, int
     }
 }
 
-static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void filter_plane(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                         int plane, int slice_start, int slice_end)
 {
     ConvolutionContext *s = ctx->priv;
-    ThreadData *td = arg;
-    AVFrame *in = td->in;
-    AVFrame *out = td->out;
-    int plane;
-
-    for (plane = 0; plane < s->nb_planes; plane++) {
-        const int mode = s->mode[plane];
-        const int bpc = s->bpc;
-        const int radius = s->size[plane] / 2;
-        const int height = s->planeheight[plane];
-        const int width  = s->planewidth[plane];
-        const int stride = in->linesize[plane];
-        const int dstride = out->linesize[plane];
-        const int sizeh = mode == MATRIX_COLUMN ? width : height;
-        const int sizew = mode == MATRIX_COLUMN ? height : width;
-        const int slice_start = (sizeh * jobnr) / nb_jobs;
-        const int slice_end = (sizeh * (jobnr+1)) / nb_jobs;
-        const float rdiv = s->rdiv[plane];
-        const float bias = s->bias[plane];
-        const uint8_t *src = in->data[plane];
-        const int dst_pos = slice_start * (mode == MATRIX_COLUMN ? bpc : dstride);
-        uint8_t *dst = out->data[plane] + dst_pos;
-        const int *matrix = s->matrix[plane];
-        const int step = mode == MATRIX_COLUMN ? 16 : 1;
-        const uint8_t *c[49];
-        int y, x;
-
-        if (s->copy[plane]) {
-            if (mode == MATRIX_COLUMN)
-                av_image_copy_plane(dst, dstride, src + slice_start * bpc, stride,
-                                    (slice_end - slice_start) * bpc, height);
-            else
-                av_image_copy_plane(dst, dstride, src + slice_start * stride, stride,
-                                    width * bpc, slice_end - slice_start);
-            continue;
+    const int mode = s->mode[plane];
+    const int bpc = s->bpc;
+    const int radius = s->size[plane] / 2;
+    const int height = s->planeheight[plane];
+    const int width  = s->planewidth[plane];
+    const int stride = in->linesize[plane];
+    const int dstride = out->linesize[plane];
+    const int sizew = mode == MATRIX_COLUMN ? height : width;
+    const float rdiv = s->rdiv[plane];
+    const float bias = s->bias[plane];
+    const uint8_t *src = in->data[plane];
+    const int dst_pos = slice_start * (mode == MATRIX_COLUMN ? bpc : dstride);
+    uint8_t *dst = out->data[plane] + dst_pos;
+    const int *matrix = s->matrix[plane];
+    const int step = mode == MATRIX_COLUMN ? 16 : 1;
+    const uint8_t *c[49];
+    int y, x;
+
+    if (s->copy[plane]) {
+        if (mode == MATRIX_COLUMN)
+            av_image_copy_plane(dst, dstride, src + slice_start * bpc, stride,
+                                (slice_end - slice_start) * bpc, height);
+        else
+            av_image_copy_plane(dst, dstride, src + slice_start * stride, stride,
+                                width * bpc, slice_end - slice_start);
+        return;
+    }
+    for (y = slice_start; y < slice_end; y += step) {
+        const int xoff = mode == MATRIX_COLUMN ? (y - slice_start) * bpc : radius * bpc;
+        const int yoff = mode == MATRIX_COLUMN ? radius * dstride : 0;
+
+        for (x = 0; x < radius; x++) {
+            const int xoff = mode == MATRIX_COLUMN ? (y - slice_start) * bpc : x * bpc;
+            const int yoff = mode == MATRIX_COLUMN ? x * dstride : 0;
+
+            s->setup[plane](radius, c, src, stride, x, width, y, height, bpc);
+            s->filter[plane](dst + yoff + xoff, 1, rdiv,
+                             bias, matrix, c, s->max, radius,
+                             dstride, stride, slice_end - step);
         }
-        for (y = slice_start; y < slice_end; y += step) {
-            const int xoff = mode == MATRIX_COLUMN ? (y - slice_start) * bpc : radius * bpc;
-            const int yoff = mode == MATRIX_COLUMN ? radius * dstride : 0;
-
-            for (x = 0; x < radius; x++) {
-                const int xoff = mode == MATRIX_COLUMN ? (y - slice_start) * bpc : x * bpc;
-                const int yoff = mode == MATRIX_COLUMN ? x * dstride : 0;
-
-                s->setup[plane](radius, c, src, stride, x, width, y, height, bpc);
-                s->filter[plane](dst + yoff + xoff, 1, rdiv,
-                                 bias, matrix, c, s->max, radius,
-                                 dstride, stride, slice_end - step);
-            }
-            s->setup[plane](radius, c, src, stride, radius, width, y, height, bpc);
-            s->filter[plane](dst + yoff + xoff, sizew - 2 * radius,
-                             rdiv, bias, matrix, c, s->max, radius,
+        s->setup[plane](radius, c, src, stride, radius, width, y, height, bpc);
+        s->filter[plane](dst + yoff + xoff, sizew - 2 * radius,
+                         rdiv, bias, matrix, c, s->max, radius,
+                         dstride, stride, slice_end - step);
+        for (x = sizew - radius; x < sizew; x++) {
+            const int xoff = mode == MATRIX_COLUMN ? (y - slice_start) * bpc : x * bpc;
+            const int yoff = mode == MATRIX_COLUMN ? x * dstride : 0;
+
+            s->setup[plane](radius, c, src, stride, x, width, y, height, bpc);
+            s->filter[plane](dst + yoff + xoff, 1, rdiv,
+                             bias, matrix, c, s->max, radius,
                              dstride, stride, slice_end - step);
-            for (x = sizew - radius; x < sizew; x++) {
-                const int xoff = mode == MATRIX_COLUMN ? (y - slice_start) * bpc : x * bpc;
-                const int yoff = mode == MATRIX_COLUMN ? x * dstride : 0;
-
-                s->setup[plane](radius, c, src, stride, x, width, y, height, bpc);
-                s->filter[plane](dst + yoff + xoff, 1, rdiv,
-                                 bias, matrix, c, s->max, radius,
-                                 dstride, stride, slice_end - step);
-            }
-            if (mode != MATRIX_COLUMN)
-                dst += dstride;
         }
+        if (mode != MATRIX_COLUMN)
+            dst += dstride;
+    }
+}
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ConvolutionContext *s = ctx->priv;
+    ThreadData *td = arg;
+
+    for (int plane = 0; plane < s->nb_planes; plane++) {
+        const int sizeh = s->mode[plane] == MATRIX_COLUMN ? s->planewidth[plane] :
+                                                            s->planeheight[plane];
+
+        filter_plane(ctx, td->in, td->out, plane, (sizeh *  jobnr   ) / nb_jobs,
+                                                  (sizeh * (jobnr+1)) / nb_jobs);
     }
 
     return 0;
 }
 
+static void filter_rows(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                        int y_start, int y_end)
+{
+    ConvolutionContext *s = ctx->priv;
+
+    for (int plane = 0; plane < s->nb_planes; plane++) {
+        const int vsub = plane == 1 || plane == 2 ? s->vsub : 0;
+
+        // column mode is only filtered in whole frames, see rows_radius()
+        if (s->mode[plane] == MATRIX_COLUMN && !s->copy[plane])
+            filter_plane(ctx, in, out, plane, 0, s->planewidth[plane]);
+        else
+            filter_plane(ctx, in, out, plane, AV_CEIL_RSHIFT(y_start, vsub),
+                                              AV_CEIL_RSHIFT(y_end,   vsub));
+    }
+}
+
+static int rows_radius(AVFilterContext *ctx)
+{
+    ConvolutionContext *s = ctx->priv;
+    int radius = 0;
+
+    for (int plane = 0; plane < s->nb_planes; plane++) {
+        const int vsub = plane == 1 || plane == 2 ? s->vsub : 0;
+
+        if (s->copy[plane])
+            continue;
+        if (s->mode[plane] == MATRIX_COLUMN)
+            return AVERROR(ENOSYS);
+        if (s->mode[plane] == MATRIX_SQUARE)
+            radius = FFMAX(radius, s->size[plane] / 2 << vsub);
+    }
+
+    return radius;
+}
+
 static int param_init(AVFilterContext *ctx)
 {
     ConvolutionContext *s = ctx->priv;
@@ -661,6 +702,7 @@ static int param_init(AVFilterContext *ctx)
     s->planewidth[0] = s->planewidth[3] = inlink->w;
     s->planeheight[1] = s->planeheight[2] = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
     s->planeheight[0] = s->planeheight[3] = inlink->h;
+    s->vsub = desc->log2_chroma_h;
 
     s->nb_planes = av_pix_fmt_count_planes(inlink->format);
     s->nb_threads = ff_filter_get_nb_threads(ctx);
@@ -883,10 +925,13 @@ const FFFilter ff_vf_convolution = {
     .p.priv_class  = &convolution_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ConvolutionContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(convolution_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .process_command = process_command,
+    .filter_rows   = filter_rows,
+    .rows_radius   = rows_radius,
 };
 
 #endif /* CONFIG_CONVOLUTION_FILTER */
@@ -909,10 +954,13 @@ const FFFilter ff_vf_prewitt = {
     .p.priv_class  = &common_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ConvolutionContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(convolution_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .process_command = process_command,
+    .filter_rows   = filter_rows,
+    .rows_radius   = rows_radius,
 };
 
 #endif /* CONFIG_PREWITT_FILTER */
@@ -925,10 +973,13 @@ const FFFilter ff_vf_sobel = {
     .p.priv_class  = &common_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ConvolutionContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(convolution_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .process_command = process_command,
+    .filter_rows   = filter_rows,
+    .rows_radius   = rows_radius,
 };
 
 #endif /* CONFIG_SOBEL_FILTER */
@@ -941,10 +992,13 @@ const FFFilter ff_vf_roberts = {
     .p.priv_class  = &common_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ConvolutionContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(convolution_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .process_command = process_command,
+    .filter_rows   = filter_rows,
+    .rows_radius   = rows_radius,
 };
 
 #endif /* CONFIG_ROBERTS_FILTER */
@@ -957,10 +1011,13 @@ const FFFilter ff_vf_kirsch = {
     .p.priv_class  = &common_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ConvolutionContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(convolution_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .process_command = process_command,
+    .filter_rows   = filter_rows,
+    .rows_radius   = rows_radius,
 };
 
 #endif /* CONFIG_KIRSCH_FILTER */
@@ -973,10 +1030,13 @@ const FFFilter ff_vf_scharr = {
     .p.priv_class  = &common_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(ConvolutionContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(convolution_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .process_command = process_command,
+    .filter_rows   = filter_rows,
+    .rows_radius   = rows_radius,
 };
 
 #endif /* CONFIG_SCHARR_FILTER */
@@ -258,6 +258,7 @@ const FFFilter ff_vf_edgedetect = {
     .p.priv_class  = &edgedetect_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
     .priv_size     = sizeof(EdgeDetectContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     .init          = init,
     .uninit        = uninit,
     FILTER_INPUTS(edgedetect_inputs),
@@ -218,27 +218,14 @@ static const enum AVPixelFormat pixel_fmts_eq[] = {
     AV_PIX_FMT_NONE
 };
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+static int prepare_rows(AVFilterContext *ctx, AVFrame *out)
 {
+    AVFilterLink *inlink = ctx->inputs[0];
     FilterLink *inl = ff_filter_link(inlink);
-    AVFilterContext *ctx = inlink->dst;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
     EQContext *eq = ctx->priv;
-    AVFrame *out;
-    const AVPixFmtDescriptor *desc;
-    int i;
-
-    out = ff_get_video_buffer(outlink, inlink->w, inlink->h);
-    if (!out) {
-        av_frame_free(&in);
-        return AVERROR(ENOMEM);
-    }
-
-    av_frame_copy_props(out, in);
-    desc = av_pix_fmt_desc_get(inlink->format);
 
     eq->var_values[VAR_N]   = inl->frame_count_out;
-    eq->var_values[VAR_T]   = TS2T(in->pts, inlink->time_base);
+    eq->var_values[VAR_T]   = TS2T(out->pts, inlink->time_base);
 
     if (eq->eval_mode == EVAL_MODE_FRAME) {
         set_gamma(eq);
@@ -247,25 +234,61 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         set_saturation(eq);
     }
 
-    for (i = 0; i < desc->nb_components; i++) {
-        int w = inlink->w;
-        int h = inlink->h;
+    /* create the tables now, filter_rows() may run concurrently */
+    for (int i = 0; i < 3; i++)
+        if (eq->param[i].adjust == apply_lut && !eq->param[i].lut_clean)
+            create_lut(&eq->param[i]);
 
-        if (i == 1 || i == 2) {
-            w = AV_CEIL_RSHIFT(w, desc->log2_chroma_w);
-            h = AV_CEIL_RSHIFT(h, desc->log2_chroma_h);
-        }
+    return 0;
+}
 
-        if (i == 3 || !eq->param[i].adjust)
-            av_image_copy_plane(out->data[i], out->linesize[i],
-                                in->data[i], in->linesize[i], w, h);
+static void filter_rows(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                        int y_start, int y_end)
+{
+    EQContext *eq = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(in->format);
+
+    for (int i = 0; i < desc->nb_components; i++) {
+        const int hsub = i == 1 || i == 2 ? desc->log2_chroma_w : 0;
+        const int vsub = i == 1 || i == 2 ? desc->log2_chroma_h : 0;
+        const int slice_start = AV_CEIL_RSHIFT(y_start, vsub);
+        const int slice_end   = AV_CEIL_RSHIFT(y_end,   vsub);
+        const int w = AV_CEIL_RSHIFT(in->width, hsub);
+        const uint8_t *src = in->data[i]  + slice_start * in->linesize[i];
+        uint8_t *dst       = out->data[i] + slice_start * out->linesize[i];
+
+        if (i == 3 || !eq->param[i].adjust) {
+            if (out != in)
+                av_image_copy_plane(dst, out->linesize[i], src, in->linesize[i],
+                                    w, slice_end - slice_start);
+        } else
+            eq->param[i].adjust(&eq->param[i], dst, out->linesize[i],
+                                src, in->linesize[i], w, slice_end - slice_start);
+    }
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *outlink = inlink->dst->outputs[0];
+    AVFrame *out;
 
-        else
-            eq->param[i].adjust(&eq->param[i], out->data[i], out->linesize[i],
-                                 in->data[i], in->linesize[i], w, h);
+    if (av_frame_is_writable(in)) {
+        out = in;
+    } else {
+        out = ff_get_video_buffer(outlink, inlink->w, inlink->h);
+        if (!out) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+        av_frame_copy_props(out, in);
     }
 
-    av_frame_free(&in);
+    prepare_rows(ctx, out);
+    filter_rows(ctx, in, out, 0, in->height);
+
+    if (out != in)
+        av_frame_free(&in);
     return ff_filter_frame(outlink, out);
 }
 
@@ -349,4 +372,6 @@ const FFFilter ff_vf_eq = {
     .process_command = process_command,
     .init            = initialize,
     .uninit          = uninit,
+    .filter_rows     = filter_rows,
+    .prepare_rows    = prepare_rows,
 };
@@ -447,6 +447,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     FilterLink      *inl = ff_filter_link(inlink);
     AVFilterContext *ctx = inlink->dst;
     FadeContext *s       = ctx->priv;
+    int ret;
 
     // Calculate Fade assuming this is a Fade In
     if (s->fade_state == VF_FADE_WAITING) {
@@ -494,7 +495,15 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         s->factor=UINT16_MAX-s->factor;
     }
 
+    /* Only copy frames which are actually faded, most of them pass through
+     * untouched. */
     if (s->factor < UINT16_MAX) {
+        ret = ff_inlink_make_frame_writable(inlink, &frame);
+        if (ret < 0) {
+            av_frame_free(&frame);
+            return ret;
+        }
+
         if (s->alpha) {
             ff_filter_execute(ctx, s->filter_slice_alpha, frame, NULL,
                               FFMIN(frame->height, ff_filter_get_nb_threads(ctx)));
@@ -554,7 +563,6 @@ static const AVFilterPad avfilter_vf_fade_inputs[] = {
     {
         .name           = "default",
         .type           = AVMEDIA_TYPE_VIDEO,
-        .flags          = AVFILTERPAD_FLAG_NEEDS_WRITABLE,
         .config_props   = config_input,
         .filter_frame   = filter_frame,
     },
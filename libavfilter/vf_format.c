@@ -195,6 +195,7 @@ const FFFilter ff_vf_format = {
     .uninit        = uninit,
 
     .priv_size     = sizeof(FormatContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
 
     FILTER_INPUTS(inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
@@ -215,6 +216,7 @@ const FFFilter ff_vf_noformat = {
     .uninit        = uninit,
 
     .priv_size     = sizeof(FormatContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
 
     FILTER_INPUTS(inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
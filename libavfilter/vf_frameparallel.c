@@ -0,0 +1,392 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Run a chain of stateless filters on several frames concurrently, with one
+ * instance of the chain per thread.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "avfilter.h"
+#include "buffersink.h"
+#include "buffersrc.h"
+#include "filters.h"
+#include "formats.h"
+#include "video.h"
+
+typedef struct FrameParallelContext {
+    const AVClass *class;
+
+    char *filters;
+
+    int nb_graphs;
+    AVFilterGraph   **graphs;
+    AVFilterContext **src;
+    AVFilterContext **sink;
+
+    // frames of the current batch, one per graph; inputs, then outputs
+    AVFrame **frames;
+    int      *rets;
+    int    nb_frames;
+
+    int     eof;
+    int     eof_status;
+    int64_t eof_pts;
+} FrameParallelContext;
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    FrameParallelContext *s = ctx->priv;
+
+    if (!s->filters || !*s->filters) {
+        av_log(ctx, AV_LOG_ERROR, "No filters specified.\n");
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    FrameParallelContext *s = ctx->priv;
+
+    for (int i = 0; i < s->nb_graphs; i++) {
+        if (s->frames)
+            av_frame_free(&s->frames[i]);
+        if (s->graphs)
+            avfilter_graph_free(&s->graphs[i]);
+    }
+    av_freep(&s->graphs);
+    av_freep(&s->src);
+    av_freep(&s->sink);
+    av_freep(&s->frames);
+    av_freep(&s->rets);
+}
+
+static int query_formats(const AVFilterContext *ctx,
+                         AVFilterFormatsConfig **cfg_in,
+                         AVFilterFormatsConfig **cfg_out)
+{
+    const AVPixFmtDescriptor *desc = NULL;
+    AVFilterFormats *formats = NULL;
+    int ret;
+
+    // the chains are made to output the input format, conversions are
+    // inserted inside them if needed
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        if (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)
+            continue;
+
+        ret = ff_add_format(&formats, av_pix_fmt_desc_get_id(desc));
+        if (ret < 0)
+            return ret;
+    }
+
+    return ff_set_common_formats2(ctx, cfg_in, cfg_out, formats);
+}
+
+static int create_graph(AVFilterContext *ctx, int idx)
+{
+    FrameParallelContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    FilterLink        *l = ff_filter_link(inlink);
+    AVBufferSrcParameters *par;
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    AVFilterGraph *graph;
+    int color_space = inlink->colorspace;
+    int color_range = inlink->color_range;
+    int ret;
+
+    graph = s->graphs[idx] = avfilter_graph_alloc();
+    if (!graph)
+        return AVERROR(ENOMEM);
+    // the parallelism is across the graphs
+    graph->nb_threads = 1;
+
+    s->src[idx]  = avfilter_graph_alloc_filter(graph, avfilter_get_by_name("buffer"), "in");
+    s->sink[idx] = avfilter_graph_alloc_filter(graph, avfilter_get_by_name("buffersink"), "out");
+    par = av_buffersrc_parameters_alloc();
+    if (!s->src[idx] || !s->sink[idx] || !par) {
+        av_freep(&par);
+        return AVERROR(ENOMEM);
+    }
+
+    par->format              = inlink->format;
+    par->width               = inlink->w;
+    par->height              = inlink->h;
+    par->sample_aspect_ratio = inlink->sample_aspect_ratio;
+    par->time_base           = inlink->time_base;
+    par->frame_rate          = l->frame_rate;
+    par->color_space         = inlink->colorspace;
+    par->color_range         = inlink->color_range;
+    ret = av_buffersrc_parameters_set(s->src[idx], par);
+    av_freep(&par);
+    if (ret < 0)
+        return ret;
+
+    ret = avfilter_init_dict(s->src[idx], NULL);
+    if (ret < 0)
+        return ret;
+
+    if ((ret = av_opt_set_array(s->sink[idx], "pixel_formats", AV_OPT_SEARCH_CHILDREN,
+                                0, 1, AV_OPT_TYPE_PIXEL_FMT, &inlink->format)) < 0 ||
+        (ret = av_opt_set_array(s->sink[idx], "colorspaces", AV_OPT_SEARCH_CHILDREN,
+                                0, 1, AV_OPT_TYPE_INT, &color_space)) < 0 ||
+        (ret = av_opt_set_array(s->sink[idx], "colorranges", AV_OPT_SEARCH_CHILDREN,
+                                0, 1, AV_OPT_TYPE_INT, &color_range)) < 0)
+        return ret;
+
+    ret = avfilter_init_dict(s->sink[idx], NULL);
+    if (ret < 0)
+        return ret;
+
+    outputs = avfilter_inout_alloc();
+    inputs  = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    outputs->name       = av_strdup("in");
+    outputs->filter_ctx = s->src[idx];
+    inputs->name        = av_strdup("out");
+    inputs->filter_ctx  = s->sink[idx];
+    if (!outputs->name || !inputs->name) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = avfilter_graph_parse_ptr(graph, s->filters, &inputs, &outputs, ctx);
+    if (ret < 0)
+        goto fail;
+
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        const AVFilterContext *f = graph->filters[i];
+
+        if (f == s->src[idx] || f == s->sink[idx] ||
+            (fffilter(f->filter)->flags_internal & FF_FILTER_FLAG_FRAME_STATELESS))
+            continue;
+
+        av_log(ctx, AV_LOG_ERROR, "Filter '%s' may depend on previous frames "
+               "and cannot be run on several frames in parallel.\n", f->filter->name);
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    // each instance only sees a part of the frames, so their frame counters
+    // do not match the ones of the stream
+    for (unsigned i = 0; i < graph->nb_filters; i++) {
+        const AVFilterContext *f = graph->filters[i];
+
+        if (!f->enable_str)
+            continue;
+
+        av_log(ctx, AV_LOG_ERROR, "Timeline editing of filter '%s' is not "
+               "supported in a parallel chain.\n", f->name);
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    ret = avfilter_graph_config(graph, ctx);
+
+fail:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    return ret;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    FrameParallelContext *s = ctx->priv;
+    FilterLink *l = ff_filter_link(outlink);
+    const AVFilterContext *sink;
+    int ret;
+
+    // an explicit number of instances is honored even with fewer threads
+    s->nb_graphs = ctx->nb_threads > 0 ? ctx->nb_threads :
+                   FFMAX(ff_filter_get_nb_threads(ctx), 1);
+
+    s->graphs = av_calloc(s->nb_graphs, sizeof(*s->graphs));
+    s->src    = av_calloc(s->nb_graphs, sizeof(*s->src));
+    s->sink   = av_calloc(s->nb_graphs, sizeof(*s->sink));
+    s->frames = av_calloc(s->nb_graphs, sizeof(*s->frames));
+    s->rets   = av_calloc(s->nb_graphs, sizeof(*s->rets));
+    if (!s->graphs || !s->src || !s->sink || !s->frames || !s->rets)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < s->nb_graphs; i++) {
+        ret = create_graph(ctx, i);
+        if (ret < 0)
+            return ret;
+    }
+
+    sink = s->sink[0];
+    outlink->w                   = av_buffersink_get_w(sink);
+    outlink->h                   = av_buffersink_get_h(sink);
+    outlink->sample_aspect_ratio = av_buffersink_get_sample_aspect_ratio(sink);
+    outlink->time_base           = av_buffersink_get_time_base(sink);
+    l->frame_rate                = av_buffersink_get_frame_rate(sink);
+
+    av_log(ctx, AV_LOG_VERBOSE, "Running %d instances of '%s'\n",
+           s->nb_graphs, s->filters);
+
+    return 0;
+}
+
+static int filter_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FrameParallelContext *s = ctx->priv;
+    AVFrame *frame = s->frames[jobnr];
+    int ret;
+
+    ret = av_buffersrc_add_frame(s->src[jobnr], frame);
+    if (ret < 0)
+        return ret;
+
+    // the source took the reference, the same frame receives the output
+    return av_buffersink_get_frame(s->sink[jobnr], frame);
+}
+
+static int filter_batch(AVFilterContext *ctx)
+{
+    FrameParallelContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    int ret = 0;
+
+    ff_filter_execute(ctx, filter_job, NULL, s->rets, s->nb_frames);
+
+    for (int i = 0; i < s->nb_frames; i++) {
+        if (!ret && s->rets[i] == AVERROR(EAGAIN)) {
+            av_log(ctx, AV_LOG_ERROR, "No frame output for an input frame, "
+                   "only filters with one output frame per input frame can be used.\n");
+            ret = AVERROR(EINVAL);
+        } else if (!ret)
+            ret = s->rets[i];
+
+        if (!ret)
+            ret = ff_filter_frame(outlink, s->frames[i]);
+        else
+            av_frame_free(&s->frames[i]);
+        s->frames[i] = NULL;
+    }
+    s->nb_frames = 0;
+
+    return ret;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    FrameParallelContext *s = ctx->priv;
+    AVFilterLink *inlink  = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    int ret;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    while (!s->eof && s->nb_frames < s->nb_graphs) {
+        ret = ff_inlink_consume_frame(inlink, &s->frames[s->nb_frames]);
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            break;
+        s->nb_frames++;
+    }
+
+    if (!s->eof && s->nb_frames < s->nb_graphs &&
+        ff_inlink_acknowledge_status(inlink, &s->eof_status, &s->eof_pts))
+        s->eof = 1;
+
+    // wait for a full batch, unless no more frames will come
+    if (s->nb_frames == s->nb_graphs || (s->eof && s->nb_frames)) {
+        ret = filter_batch(ctx);
+        if (ret < 0)
+            return ret;
+        ff_filter_set_ready(ctx, 100);
+        return 0;
+    }
+
+    if (s->eof) {
+        ff_outlink_set_status(outlink, s->eof_status, s->eof_pts);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+
+static int process_command(AVFilterContext *ctx, const char *cmd, const char *args,
+                           char *res, int res_len, int flags)
+{
+    FrameParallelContext *s = ctx->priv;
+    int ret = AVERROR(ENOSYS);
+
+    if (!strcmp(cmd, "enable")) {
+        av_log(ctx, AV_LOG_ERROR, "Timeline editing is not supported in a "
+               "parallel chain.\n");
+        return AVERROR(EINVAL);
+    }
+
+    for (int i = 0; i < s->nb_graphs; i++) {
+        ret = avfilter_graph_send_command(s->graphs[i], "all", cmd, args,
+                                          res, res_len, flags);
+        if (ret < 0)
+            break;
+    }
+
+    return ret;
+}
+
+#define OFFSET(x) offsetof(FrameParallelContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption frameparallel_options[] = {
+    { "filters", "set the chain of stateless filters to run", OFFSET(filters), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(frameparallel);
+
+static const AVFilterPad outputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_output,
+    },
+};
+
+const FFFilter ff_vf_frameparallel = {
+    .p.name          = "frameparallel",
+    .p.description   = NULL_IF_CONFIG_SMALL("Run stateless filters on several frames in parallel."),
+    .p.priv_class    = &frameparallel_class,
+    .p.flags         = AVFILTER_FLAG_SLICE_THREADS,
+    .priv_size       = sizeof(FrameParallelContext),
+    .init            = init,
+    .uninit          = uninit,
+    .activate        = activate,
+    .process_command = process_command,
+    FILTER_INPUTS(ff_video_default_filterpad),
+    FILTER_OUTPUTS(outputs),
+    FILTER_QUERY_FUNC2(query_formats),
+};
@@ -320,6 +320,7 @@ const FFFilter ff_vf_gblur = {
     .p.priv_class  = &gblur_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(GBlurContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     .uninit        = uninit,
     FILTER_INPUTS(gblur_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
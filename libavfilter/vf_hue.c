@@ -357,40 +357,24 @@ static void apply_lut10(HueContext *s,
     }
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *inpic)
+static int prepare_rows(AVFilterContext *ctx, AVFrame *outpic)
 {
+    AVFilterLink *inlink = ctx->inputs[0];
     FilterLink *inl = ff_filter_link(inlink);
-    HueContext *hue = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
-    AVFrame *outpic;
+    HueContext *hue = ctx->priv;
     const int32_t old_hue_sin = hue->hue_sin, old_hue_cos = hue->hue_cos;
     const float old_brightness = hue->brightness;
-    int direct = 0;
-    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
-    const int bps = desc->comp[0].depth > 8 ? 2 : 1;
-
-    if (av_frame_is_writable(inpic)) {
-        direct = 1;
-        outpic = inpic;
-    } else {
-        outpic = ff_get_video_buffer(outlink, outlink->w, outlink->h);
-        if (!outpic) {
-            av_frame_free(&inpic);
-            return AVERROR(ENOMEM);
-        }
-        av_frame_copy_props(outpic, inpic);
-    }
 
     hue->var_values[VAR_N]   = inl->frame_count_out;
-    hue->var_values[VAR_T]   = TS2T(inpic->pts, inlink->time_base);
-    hue->var_values[VAR_PTS] = TS2D(inpic->pts);
+    hue->var_values[VAR_T]   = TS2T(outpic->pts, inlink->time_base);
+    hue->var_values[VAR_PTS] = TS2D(outpic->pts);
 
     if (hue->saturation_expr) {
         hue->saturation = av_expr_eval(hue->saturation_pexpr, hue->var_values, NULL);
 
         if (hue->saturation < SAT_MIN_VAL || hue->saturation > SAT_MAX_VAL) {
             hue->saturation = av_clip(hue->saturation, SAT_MIN_VAL, SAT_MAX_VAL);
-            av_log(inlink->dst, AV_LOG_WARNING,
+            av_log(ctx, AV_LOG_WARNING,
                    "Saturation value not in range [%d,%d]: clipping value to %0.1f\n",
                    SAT_MIN_VAL, SAT_MAX_VAL, hue->saturation);
         }
@@ -401,7 +385,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *inpic)
 
         if (hue->brightness < -10 || hue->brightness > 10) {
             hue->brightness = av_clipf(hue->brightness, -10, 10);
-            av_log(inlink->dst, AV_LOG_WARNING,
+            av_log(ctx, AV_LOG_WARNING,
                    "Brightness value not in range [%d,%d]: clipping value to %0.1f\n",
                    -10, 10, hue->brightness);
         }
@@ -415,7 +399,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *inpic)
         hue->hue_deg = hue->hue * 180 / M_PI;
     }
 
-    av_log(inlink->dst, AV_LOG_DEBUG,
+    av_log(ctx, AV_LOG_DEBUG,
            "H:%0.1f*PI h:%0.1f s:%0.1f b:%0.f t:%0.1f n:%d\n",
            hue->hue/M_PI, hue->hue_deg, hue->saturation, hue->brightness,
            hue->var_values[VAR_T], (int)hue->var_values[VAR_N]);
@@ -427,39 +411,80 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *inpic)
     if (hue->is_first || (old_brightness != hue->brightness && hue->brightness))
         create_luma_lut(hue);
 
-    if (!direct) {
+    hue->is_first = 0;
+    return 0;
+}
+
+static void filter_rows(AVFilterContext *ctx, const AVFrame *inpic, AVFrame *outpic,
+                        int y_start, int y_end)
+{
+    HueContext *hue = ctx->priv;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inpic->format);
+    const int bps = desc->comp[0].depth > 8 ? 2 : 1;
+    const int w  = inpic->width;
+    const int h  = y_end - y_start;
+    const int cw = AV_CEIL_RSHIFT(w, hue->hsub);
+    const int cy = AV_CEIL_RSHIFT(y_start, hue->vsub);
+    const int ch = AV_CEIL_RSHIFT(y_end, hue->vsub) - cy;
+    uint8_t *src[4], *dst[4];
+
+    for (int p = 0; p < 4 && inpic->data[p]; p++) {
+        const int y = p == 1 || p == 2 ? cy : y_start;
+        src[p] = inpic->data[p]  + y * inpic->linesize[p];
+        dst[p] = outpic->data[p] + y * outpic->linesize[p];
+    }
+
+    if (outpic != inpic) {
         if (!hue->brightness)
-            av_image_copy_plane(outpic->data[0], outpic->linesize[0],
-                                inpic->data[0],   inpic->linesize[0],
-                                inlink->w * bps, inlink->h);
+            av_image_copy_plane(dst[0], outpic->linesize[0],
+                                src[0], inpic->linesize[0], w * bps, h);
         if (inpic->data[3])
-            av_image_copy_plane(outpic->data[3], outpic->linesize[3],
-                                inpic->data[3],   inpic->linesize[3],
-                                inlink->w * bps, inlink->h);
+            av_image_copy_plane(dst[3], outpic->linesize[3],
+                                src[3], inpic->linesize[3], w * bps, h);
     }
 
     if (bps > 1) {
-        apply_lut10(hue, (uint16_t*)outpic->data[1], (uint16_t*)outpic->data[2], outpic->linesize[1]/2,
-                         (uint16_t*) inpic->data[1], (uint16_t*) inpic->data[2],  inpic->linesize[1]/2,
-                    AV_CEIL_RSHIFT(inlink->w, hue->hsub),
-                    AV_CEIL_RSHIFT(inlink->h, hue->vsub));
+        apply_lut10(hue, (uint16_t*)dst[1], (uint16_t*)dst[2], outpic->linesize[1]/2,
+                         (uint16_t*)src[1], (uint16_t*)src[2],  inpic->linesize[1]/2,
+                    cw, ch);
         if (hue->brightness)
-            apply_luma_lut10(hue, (uint16_t*)outpic->data[0], outpic->linesize[0]/2,
-                                  (uint16_t*) inpic->data[0],  inpic->linesize[0]/2, inlink->w, inlink->h);
+            apply_luma_lut10(hue, (uint16_t*)dst[0], outpic->linesize[0]/2,
+                                  (uint16_t*)src[0],  inpic->linesize[0]/2, w, h);
     } else {
-        apply_lut(hue, outpic->data[1], outpic->data[2], outpic->linesize[1],
-                       inpic->data[1],   inpic->data[2],  inpic->linesize[1],
-                  AV_CEIL_RSHIFT(inlink->w, hue->hsub),
-                  AV_CEIL_RSHIFT(inlink->h, hue->vsub));
+        apply_lut(hue, dst[1], dst[2], outpic->linesize[1],
+                       src[1], src[2],  inpic->linesize[1],
+                  cw, ch);
         if (hue->brightness)
-            apply_luma_lut(hue, outpic->data[0], outpic->linesize[0],
-                                inpic->data[0],  inpic->linesize[0], inlink->w, inlink->h);
+            apply_luma_lut(hue, dst[0], outpic->linesize[0],
+                                src[0],  inpic->linesize[0], w, h);
+    }
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *inpic)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *outpic;
+    int direct = 0;
+
+    if (av_frame_is_writable(inpic)) {
+        direct = 1;
+        outpic = inpic;
+    } else {
+        outpic = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!outpic) {
+            av_frame_free(&inpic);
+            return AVERROR(ENOMEM);
+        }
+        av_frame_copy_props(outpic, inpic);
     }
 
+    prepare_rows(ctx, outpic);
+    filter_rows(ctx, inpic, outpic, 0, inpic->height);
+
     if (!direct)
         av_frame_free(&inpic);
 
-    hue->is_first = 0;
     return ff_filter_frame(outlink, outpic);
 }
 
@@ -514,4 +539,6 @@ const FFFilter ff_vf_hue = {
     FILTER_INPUTS(hue_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
+    .filter_rows     = filter_rows,
+    .prepare_rows    = prepare_rows,
 };
@@ -0,0 +1,277 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Scale the input to several resolutions at once, deriving every rung of the
+ * ladder from the previous one instead of from the full resolution input.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "video.h"
+
+typedef struct LadderContext {
+    const AVClass *class;
+
+    char *sizes_str;
+    char *flags_str;
+
+    int nb_rungs;
+    int *w, *h;
+    SwsContext **sws;
+
+    AVFrame **frames;
+} LadderContext;
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    LadderContext   *s   = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    int idx = FF_OUTLINK_IDX(outlink);
+
+    s->sws[idx]->threads = ff_filter_get_nb_threads(ctx);
+
+    outlink->w = s->w[idx];
+    outlink->h = s->h[idx];
+
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    av_log(ctx, AV_LOG_VERBOSE, "rung:%d w:%d h:%d fmt:%s from w:%d h:%d\n",
+           idx, outlink->w, outlink->h, av_get_pix_fmt_name(outlink->format),
+           idx ? s->w[idx - 1] : inlink->w, idx ? s->h[idx - 1] : inlink->h);
+
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    LadderContext *s = ctx->priv;
+    char *p, *arg, *saveptr = NULL;
+    int ret;
+
+    if (!s->sizes_str || !*s->sizes_str) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified.\n");
+        return AVERROR(EINVAL);
+    }
+
+    p = s->sizes_str;
+    while ((arg = av_strtok(p, "|", &saveptr))) {
+        int w, h;
+
+        p = NULL;
+
+        ret = av_parse_video_size(&w, &h, arg);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid output size '%s'.\n", arg);
+            return ret;
+        }
+
+        ret = av_reallocp_array(&s->w, s->nb_rungs + 1, sizeof(*s->w));
+        if (ret < 0)
+            return ret;
+        ret = av_reallocp_array(&s->h, s->nb_rungs + 1, sizeof(*s->h));
+        if (ret < 0)
+            return ret;
+
+        s->w[s->nb_rungs] = w;
+        s->h[s->nb_rungs] = h;
+        s->nb_rungs++;
+    }
+
+    s->sws    = av_calloc(s->nb_rungs, sizeof(*s->sws));
+    s->frames = av_calloc(s->nb_rungs, sizeof(*s->frames));
+    if (!s->sws || !s->frames)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < s->nb_rungs; i++) {
+        AVFilterPad pad = { 0 };
+
+        s->sws[i] = sws_alloc_context();
+        if (!s->sws[i])
+            return AVERROR(ENOMEM);
+
+        if (s->flags_str && *s->flags_str) {
+            ret = av_opt_set(s->sws[i], "sws_flags", s->flags_str, 0);
+            if (ret < 0)
+                return ret;
+        }
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name = av_asprintf("output%d", i);
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+
+        ret = ff_append_outpad_free_name(ctx, &pad);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    LadderContext *s = ctx->priv;
+
+    for (int i = 0; i < s->nb_rungs; i++) {
+        if (s->sws)
+            sws_free_context(&s->sws[i]);
+        if (s->frames)
+            av_frame_free(&s->frames[i]);
+    }
+    av_freep(&s->sws);
+    av_freep(&s->frames);
+    av_freep(&s->w);
+    av_freep(&s->h);
+}
+
+static int query_formats(const AVFilterContext *ctx,
+                         AVFilterFormatsConfig **cfg_in,
+                         AVFilterFormatsConfig **cfg_out)
+{
+    const AVPixFmtDescriptor *desc = NULL;
+    AVFilterFormats *formats = NULL;
+    int ret;
+
+    // every rung is both an output and an input of the scaler
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+
+        if (sws_test_format(pix_fmt, 0) && sws_test_format(pix_fmt, 1)) {
+            ret = ff_add_format(&formats, pix_fmt);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return ff_set_common_formats2(ctx, cfg_in, cfg_out, formats);
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    LadderContext   *s   = ctx->priv;
+    const AVFrame *src   = in;
+    int nb_needed = 0, ret = 0;
+
+    // rungs past the last open output need not be computed
+    for (int i = 0; i < s->nb_rungs; i++)
+        if (!ff_outlink_get_status(ctx->outputs[i]))
+            nb_needed = i + 1;
+
+    // all outputs are closed, so stop taking input, as split does
+    if (!nb_needed) {
+        av_frame_free(&in);
+        ff_inlink_set_status(inlink, AVERROR_EOF);
+        return 0;
+    }
+
+    for (int i = 0; i < nb_needed; i++) {
+        AVFilterLink *outlink = ctx->outputs[i];
+        AVFrame *out;
+
+        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        s->frames[i] = out;
+
+        ret = av_frame_copy_props(out, in);
+        if (ret < 0)
+            goto fail;
+
+        ret = sws_scale_frame(s->sws[i], out, src);
+        if (ret < 0)
+            goto fail;
+
+        src = out;
+    }
+
+    av_frame_free(&in);
+
+    for (int i = 0; i < nb_needed; i++) {
+        AVFrame *out = s->frames[i];
+
+        s->frames[i] = NULL;
+
+        if (ff_outlink_get_status(ctx->outputs[i])) {
+            av_frame_free(&out);
+            continue;
+        }
+
+        ret = ff_filter_frame(ctx->outputs[i], out);
+        if (ret < 0)
+            goto fail;
+    }
+
+    return 0;
+fail:
+    av_frame_free(&in);
+    for (int i = 0; i < s->nb_rungs; i++)
+        av_frame_free(&s->frames[i]);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(LadderContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption ladder_options[] = {
+    { "sizes", "set the '|'-separated list of output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
+    { "flags", "set the libswscale scaling flags",           OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "" },   0, 0, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(ladder);
+
+static const AVFilterPad inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = filter_frame,
+    },
+};
+
+const FFFilter ff_vf_ladder = {
+    .p.name        = "ladder",
+    .p.description = NULL_IF_CONFIG_SMALL("Scale the input to multiple sizes, each derived from the previous one."),
+    .p.priv_class  = &ladder_class,
+    .p.flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .priv_size     = sizeof(LadderContext),
+    .init          = init,
+    .uninit        = uninit,
+    FILTER_INPUTS(inputs),
+    FILTER_QUERY_FUNC2(query_formats),
+};
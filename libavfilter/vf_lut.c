@@ -316,7 +316,9 @@ static int config_props(AVFilterLink *inlink)
         s->var_values[VAR_MAXVAL] = max[color];
         s->var_values[VAR_MINVAL] = min[color];
 
-        for (val = 0; val < FF_ARRAY_ELEMS(s->lut[comp]); val++) {
+        /* samples never exceed the component depth, skip the unreachable
+         * part of the table */
+        for (val = 0; val < 1 << desc->comp[color].depth; val++) {
             s->var_values[VAR_VAL] = val;
             s->var_values[VAR_CLIPVAL] = av_clip(val, min[color], max[color]);
             s->var_values[VAR_NEGVAL] =
@@ -338,31 +340,17 @@ static int config_props(AVFilterLink *inlink)
     return 0;
 }
 
-struct thread_data {
-    AVFrame *in;
-    AVFrame *out;
-
-    int w;
-    int h;
-};
-
 #define LOAD_PACKED_COMMON\
-    LutContext *s = ctx->priv;\
-    const struct thread_data *td = arg;\
+    const LutContext *s = ctx->priv;\
 \
     int i, j;\
-    const int w = td->w;\
-    const int h = td->h;\
-    AVFrame *in = td->in;\
-    AVFrame *out = td->out;\
+    const int w = in->width;\
     const uint16_t (*tab)[256*256] = (const uint16_t (*)[256*256])s->lut;\
     const int step = s->step;\
-\
-    const int slice_start = (h *  jobnr   ) / nb_jobs;\
-    const int slice_end   = (h * (jobnr+1)) / nb_jobs;\
 
 /* packed, 16-bit */
-static int lut_packed_16bits(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void lut_packed_16bits(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                              int slice_start, int slice_end)
 {
     LOAD_PACKED_COMMON
 
@@ -394,12 +382,11 @@ static int lut_packed_16bits(AVFilterContext *ctx, void *arg, int jobnr, int nb_
             inrow  += step;
         }
     }
-
-    return 0;
 }
 
 /* packed, 8-bit */
-static int lut_packed_8bits(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void lut_packed_8bits(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                             int slice_start, int slice_end)
 {
     LOAD_PACKED_COMMON
 
@@ -423,29 +410,24 @@ static int lut_packed_8bits(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
             inrow  += step;
         }
     }
-
-    return 0;
 }
 
 #define LOAD_PLANAR_COMMON\
-    LutContext *s = ctx->priv;\
-    const struct thread_data *td = arg;\
+    const LutContext *s = ctx->priv;\
     int i, j, plane;\
-    AVFrame *in = td->in;\
-    AVFrame *out = td->out;\
 
 #define PLANAR_COMMON\
         int vsub = plane == 1 || plane == 2 ? s->vsub : 0;\
         int hsub = plane == 1 || plane == 2 ? s->hsub : 0;\
-        int h = AV_CEIL_RSHIFT(td->h, vsub);\
-        int w = AV_CEIL_RSHIFT(td->w, hsub);\
+        int w = AV_CEIL_RSHIFT(in->width, hsub);\
         const uint16_t *tab = s->lut[plane];\
 \
-        const int slice_start = (h *  jobnr   ) / nb_jobs;\
-        const int slice_end   = (h * (jobnr+1)) / nb_jobs;\
+        const int slice_start = AV_CEIL_RSHIFT(y_start, vsub);\
+        const int slice_end   = AV_CEIL_RSHIFT(y_end,   vsub);\
 
 /* planar >8 bit depth */
-static int lut_planar_16bits(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void lut_planar_16bits(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                              int y_start, int y_end)
 {
     LOAD_PLANAR_COMMON
 
@@ -472,12 +454,11 @@ static int lut_planar_16bits(AVFilterContext *ctx, void *arg, int jobnr, int nb_
             outrow += out_linesize;
         }
     }
-
-    return 0;
 }
 
 /* planar 8bit depth */
-static int lut_planar_8bits(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void lut_planar_8bits(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                             int y_start, int y_end)
 {
     LOAD_PLANAR_COMMON
 
@@ -499,31 +480,55 @@ static int lut_planar_8bits(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
             outrow += out_linesize;
         }
     }
+}
+
+static void filter_rows(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                        int y_start, int y_end)
+{
+    const LutContext *s = ctx->priv;
+
+    if (s->is_rgb && s->is_16bit && !s->is_planar) {
+        /* packed, 16-bit */
+        lut_packed_16bits(ctx, in, out, y_start, y_end);
+    } else if (s->is_rgb && !s->is_planar) {
+        /* packed 8 bits */
+        lut_packed_8bits(ctx, in, out, y_start, y_end);
+    } else if (s->is_16bit) {
+        /* planar >8 bit depth */
+        lut_planar_16bits(ctx, in, out, y_start, y_end);
+    } else {
+        /* planar 8bit depth */
+        lut_planar_8bits(ctx, in, out, y_start, y_end);
+    }
+}
+
+struct thread_data {
+    AVFrame *in;
+    AVFrame *out;
+};
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const struct thread_data *td = arg;
+    const int h = td->in->height;
+
+    filter_rows(ctx, td->in, td->out, (h * jobnr) / nb_jobs, (h * (jobnr+1)) / nb_jobs);
 
     return 0;
 }
 
-#define PACKED_THREAD_DATA\
- struct thread_data td = {\
-            .in  = in,\
-            .out = out,\
-            .w   = inlink->w,\
-            .h   = in->height,\
-        };\
-
-#define PLANAR_THREAD_DATA\
- struct thread_data td = {\
-            .in  = in,\
-            .out = out,\
-            .w   = inlink->w,\
-            .h   = inlink->h,\
-        };\
+static int prepare_rows(AVFilterContext *ctx, AVFrame *out)
+{
+    av_frame_side_data_remove_by_props(&out->side_data, &out->nb_side_data,
+                                       AV_SIDE_DATA_PROP_COLOR_DEPENDENT);
+    return 0;
+}
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
-    LutContext *s = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
+    struct thread_data td;
     AVFrame *out;
     int direct = 0;
 
@@ -539,30 +544,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         av_frame_copy_props(out, in);
     }
 
-    av_frame_side_data_remove_by_props(&out->side_data, &out->nb_side_data,
-                                       AV_SIDE_DATA_PROP_COLOR_DEPENDENT);
+    prepare_rows(ctx, out);
 
-    if (s->is_rgb && s->is_16bit && !s->is_planar) {
-        /* packed, 16-bit */
-        PACKED_THREAD_DATA
-        ff_filter_execute(ctx, lut_packed_16bits, &td, NULL,
-                          FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
-    } else if (s->is_rgb && !s->is_planar) {
-        /* packed 8 bits */
-        PACKED_THREAD_DATA
-        ff_filter_execute(ctx, lut_packed_8bits, &td, NULL,
-                          FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
-    } else if (s->is_16bit) {
-        /* planar >8 bit depth */
-        PLANAR_THREAD_DATA
-        ff_filter_execute(ctx, lut_planar_16bits, &td, NULL,
-                          FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
-    } else {
-        /* planar 8bit depth */
-        PLANAR_THREAD_DATA
-        ff_filter_execute(ctx, lut_planar_8bits, &td, NULL,
-                          FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
-    }
+    td.in  = in;
+    td.out = out;
+    ff_filter_execute(ctx, filter_slice, &td, NULL,
+                      FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
 
     if (!direct)
         av_frame_free(&in);
@@ -597,12 +584,15 @@ static const AVFilterPad inputs[] = {
         .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC |       \
                          AVFILTER_FLAG_SLICE_THREADS,                   \
         .priv_size     = sizeof(LutContext),                            \
+        .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,               \
         .init          = name_##_init,                                  \
         .uninit        = uninit,                                        \
         FILTER_INPUTS(inputs),                                          \
         FILTER_OUTPUTS(ff_video_default_filterpad),                     \
         FILTER_QUERY_FUNC2(query_formats),                              \
         .process_command = process_command,                             \
+        .filter_rows   = filter_rows,                                   \
+        .prepare_rows  = prepare_rows,                                  \
     }
 
 AVFILTER_DEFINE_CLASS_EXT(lut, "lut/lutyuv/lutrgb", options);
@@ -276,6 +276,7 @@ const FFFilter ff_vf_median = {
     .p.priv_class  = &median_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(MedianContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     .uninit        = uninit,
     FILTER_INPUTS(median_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
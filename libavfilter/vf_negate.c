@@ -50,6 +50,7 @@ typedef struct NegateContext {
     int linesize[4];
     int width[4];
     int height[4];
+    int vsub;
     uint8_t rgba_map[4];
 
     void (*negate)(const uint8_t *src, uint8_t *dst,
@@ -250,6 +251,7 @@ static int config_input(AVFilterLink *inlink)
     depth = desc->comp[0].depth;
     hsub = desc->log2_chroma_w;
     vsub = desc->log2_chroma_h;
+    s->vsub = vsub;
     s->height[1] = s->height[2] = AV_CEIL_RSHIFT(inlink->h, vsub);
     s->height[0] = s->height[3] = inlink->h;
     s->width[1]  = s->width[2]  = AV_CEIL_RSHIFT(inlink->w, hsub);
@@ -268,17 +270,15 @@ static int config_input(AVFilterLink *inlink)
     return 0;
 }
 
-static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void filter_rows(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                        int y_start, int y_end)
 {
     NegateContext *s = ctx->priv;
-    ThreadData *td = arg;
-    AVFrame *in = td->in;
-    AVFrame *out = td->out;
 
     for (int p = 0; p < s->nb_planes; p++) {
-        const int h = s->height[p];
-        const int slice_start = (h * jobnr) / nb_jobs;
-        const int slice_end = (h * (jobnr+1)) / nb_jobs;
+        const int vsub = p == 1 || p == 2 ? s->vsub : 0;
+        const int slice_start = AV_CEIL_RSHIFT(y_start, vsub);
+        const int slice_end   = AV_CEIL_RSHIFT(y_end,   vsub);
 
         if (!((1 << p) & s->planes)) {
             if (out != in)
@@ -296,6 +296,15 @@ static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
                   s->width[p], slice_end - slice_start,
                   s->max, s->step, s->components);
     }
+}
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    NegateContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int h = s->height[0];
+
+    filter_rows(ctx, td->in, td->out, (h * jobnr) / nb_jobs, (h * (jobnr+1)) / nb_jobs);
 
     return 0;
 }
@@ -361,8 +370,10 @@ const FFFilter ff_vf_negate = {
     .p.priv_class  = &negate_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(NegateContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .process_command = process_command,
+    .filter_rows     = filter_rows,
 };
@@ -307,6 +307,7 @@ const FFFilter ff_vf_smartblur = {
     .p.priv_class  = &smartblur_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
     .priv_size     = sizeof(SmartblurContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     .init          = init,
     .uninit        = uninit,
     FILTER_INPUTS(smartblur_inputs),
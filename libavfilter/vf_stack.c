@@ -143,23 +143,44 @@ static av_cold int init(AVFilterContext *ctx)
     return 0;
 }
 
+/*
+ * Each job fills and copies a band of output rows from all inputs, rather
+ * than whole inputs, so that the work is balanced even with few or unevenly
+ * sized inputs and each output row is only touched by one thread.
+ */
 static int process_slice(AVFilterContext *ctx, void *arg, int job, int nb_jobs)
 {
     StackContext *s = ctx->priv;
     AVFrame *out = arg;
     AVFrame **in = s->frames;
-    const int start = (s->nb_inputs *  job   ) / nb_jobs;
-    const int end   = (s->nb_inputs * (job+1)) / nb_jobs;
+    const int align = 1 << s->desc->log2_chroma_h;
+    const int start = ((out->height * job) / nb_jobs) & ~(align - 1);
+    const int end   = job == nb_jobs - 1 ? out->height :
+                      ((out->height * (job + 1)) / nb_jobs) & ~(align - 1);
+
+    if (start >= end)
+        return 0;
+
+    if (s->fillcolor_enable)
+        ff_fill_rectangle(&s->draw, &s->color, out->data, out->linesize,
+                          0, start, out->width, end - start);
 
-    for (int i = start; i < end; i++) {
+    for (int i = 0; i < s->nb_inputs; i++) {
         StackItem *item = &s->items[i];
 
         for (int p = 0; p < s->nb_planes; p++) {
-            av_image_copy_plane(out->data[p] + out->linesize[p] * item->y[p] + item->x[p],
+            const int vsub = (p == 1 || p == 2) ? s->desc->log2_chroma_h : 0;
+            const int y0 = FFMAX(item->y[p], AV_CEIL_RSHIFT(start, vsub));
+            const int y1 = FFMIN(item->y[p] + item->height[p], AV_CEIL_RSHIFT(end, vsub));
+
+            if (y0 >= y1)
+                continue;
+
+            av_image_copy_plane(out->data[p] + out->linesize[p] * y0 + item->x[p],
                                 out->linesize[p],
-                                in[i]->data[p],
+                                in[i]->data[p] + in[i]->linesize[p] * (y0 - item->y[p]),
                                 in[i]->linesize[p],
-                                item->linesize[p], item->height[p]);
+                                item->linesize[p], y1 - y0);
         }
     }
 
@@ -186,12 +207,9 @@ static int process_frame(FFFrameSync *fs)
     out->pts = av_rescale_q(s->fs.pts, s->fs.time_base, outlink->time_base);
     out->sample_aspect_ratio = outlink->sample_aspect_ratio;
 
-    if (s->fillcolor_enable)
-        ff_fill_rectangle(&s->draw, &s->color, out->data, out->linesize,
-                          0, 0, outlink->w, outlink->h);
-
     ff_filter_execute(ctx, process_slice, out, NULL,
-                      FFMIN(s->nb_inputs, ff_filter_get_nb_threads(ctx)));
+                      FFMIN(AV_CEIL_RSHIFT(outlink->h, s->desc->log2_chroma_h),
+                            ff_filter_get_nb_threads(ctx)));
 
     return ff_filter_frame(outlink, out);
 }
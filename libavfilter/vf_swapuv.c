@@ -96,6 +96,7 @@ const FFFilter ff_vf_swapuv = {
     .p.name        = "swapuv",
     .p.description = NULL_IF_CONFIG_SMALL("Swap U and V components."),
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(swapuv_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_QUERY_FUNC2(query_formats),
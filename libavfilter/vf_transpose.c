@@ -413,6 +413,7 @@ const FFFilter ff_vf_transpose = {
     .p.priv_class  = &transpose_class,
     .p.flags       = AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(TransContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(avfilter_vf_transpose_inputs),
     FILTER_OUTPUTS(avfilter_vf_transpose_outputs),
     FILTER_QUERY_FUNC2(query_formats),
@@ -60,6 +60,16 @@ typedef struct UnsharpFilterParam {
     uint32_t **sc;       ///< finite state machine storage across rows
 } UnsharpFilterParam;
 
+typedef struct TheadData {
+    UnsharpFilterParam *fp;
+    uint8_t       *dst;
+    const uint8_t *src;
+    int dst_stride;
+    int src_stride;
+    int width;
+    int height;
+} ThreadData;
+
 typedef struct UnsharpContext {
     const AVClass *class;
     int lmsize_x, lmsize_y, cmsize_x, cmsize_y;
@@ -75,22 +85,14 @@ typedef struct UnsharpContext {
     int bps;
     int nb_threads;
     int (* unsharp_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
+    void (*unsharp_rows)(AVFilterContext *ctx, const ThreadData *td, int jobnr,
+                         int slice_start, int slice_end);
 } UnsharpContext;
 
-typedef struct TheadData {
-    UnsharpFilterParam *fp;
-    uint8_t       *dst;
-    const uint8_t *src;
-    int dst_stride;
-    int src_stride;
-    int width;
-    int height;
-} ThreadData;
-
 #define DEF_UNSHARP_SLICE_FUNC(name, nbits)                                                           \
-static int name##_##nbits(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)                    \
+static void name##_rows_##nbits(AVFilterContext *ctx, const ThreadData *td, int jobnr,                \
+                                int slice_start, int slice_end)                                       \
 {                                                                                                     \
-    ThreadData *td = arg;                                                                             \
     UnsharpFilterParam *fp = td->fp;                                                                  \
     UnsharpContext *s = ctx->priv;                                                                    \
     uint32_t **sc = fp->sc;                                                                           \
@@ -110,8 +112,6 @@ static int name##_##nbits(AVFilterContext *ctx, void *arg, int jobnr, int nb_job
     const int height = td->height;                                                                    \
     const int sc_offset = jobnr * 2 * steps_y;                                                        \
     const int sr_offset = jobnr * (MAX_MATRIX_SIZE - 1);                                              \
-    const int slice_start = (height * jobnr) / nb_jobs;                                               \
-    const int slice_end = (height * (jobnr+1)) / nb_jobs;                                             \
                                                                                                       \
     int32_t res;                                                                                      \
     int x, y, z;                                                                                      \
@@ -121,7 +121,7 @@ static int name##_##nbits(AVFilterContext *ctx, void *arg, int jobnr, int nb_job
         av_image_copy_plane(td->dst + slice_start * dst_stride, dst_stride,                           \
                             td->src + slice_start * src_stride, src_stride,                           \
                             width * s->bps, slice_end - slice_start);                                 \
-        return 0;                                                                                     \
+        return;                                                                                       \
     }                                                                                                 \
                                                                                                       \
     for (y = 0; y < 2 * steps_y; y++)                                                                 \
@@ -167,40 +167,70 @@ static int name##_##nbits(AVFilterContext *ctx, void *arg, int jobnr, int nb_job
             src += src_stride;                                                                        \
         }                                                                                             \
     }                                                                                                 \
+}                                                                                                     \
+                                                                                                      \
+static int name##_##nbits(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)                    \
+{                                                                                                     \
+    const ThreadData *td = arg;                                                                       \
+                                                                                                      \
+    name##_rows_##nbits(ctx, td, jobnr, (td->height *  jobnr   ) / nb_jobs,                           \
+                                        (td->height * (jobnr+1)) / nb_jobs);                          \
     return 0;                                                                                         \
 }
 DEF_UNSHARP_SLICE_FUNC(unsharp_slice, 16)
 DEF_UNSHARP_SLICE_FUNC(unsharp_slice, 8)
 
-static int apply_unsharp(AVFilterContext *ctx, AVFrame *in, AVFrame *out)
+static void init_thread_data(AVFilterContext *ctx, ThreadData *td,
+                             const AVFrame *in, AVFrame *out, int plane)
 {
     AVFilterLink *inlink = ctx->inputs[0];
     UnsharpContext *s = ctx->priv;
-    int i, plane_w[4], plane_h[4];
-    UnsharpFilterParam *fp[4];
+    const int chroma = plane == 1 || plane == 2;
+
+    td->fp = chroma ? &s->chroma : plane == 3 ? &s->alpha : &s->luma;
+    td->dst = out->data[plane];
+    td->src = in->data[plane];
+    td->width  = chroma ? AV_CEIL_RSHIFT(inlink->w, s->hsub) : inlink->w;
+    td->height = chroma ? AV_CEIL_RSHIFT(inlink->h, s->vsub) : inlink->h;
+    td->dst_stride = out->linesize[plane];
+    td->src_stride = in->linesize[plane];
+}
+
+static int apply_unsharp(AVFilterContext *ctx, AVFrame *in, AVFrame *out)
+{
+    UnsharpContext *s = ctx->priv;
     ThreadData td;
 
-    plane_w[0] = plane_w[3] = inlink->w;
-    plane_w[1] = plane_w[2] = AV_CEIL_RSHIFT(inlink->w, s->hsub);
-    plane_h[0] = plane_h[3] = inlink->h;
-    plane_h[1] = plane_h[2] = AV_CEIL_RSHIFT(inlink->h, s->vsub);
-    fp[0] = &s->luma;
-    fp[1] = fp[2] = &s->chroma;
-    fp[3] = &s->alpha;
-    for (i = 0; i < s->nb_planes; i++) {
-        td.fp = fp[i];
-        td.dst = out->data[i];
-        td.src = in->data[i];
-        td.width = plane_w[i];
-        td.height = plane_h[i];
-        td.dst_stride = out->linesize[i];
-        td.src_stride = in->linesize[i];
+    for (int i = 0; i < s->nb_planes; i++) {
+        init_thread_data(ctx, &td, in, out, i);
         ff_filter_execute(ctx, s->unsharp_slice, &td, NULL,
-                          FFMIN(plane_h[i], s->nb_threads));
+                          FFMIN(td.height, s->nb_threads));
     }
     return 0;
 }
 
+static void filter_rows(AVFilterContext *ctx, const AVFrame *in, AVFrame *out,
+                        int y_start, int y_end)
+{
+    UnsharpContext *s = ctx->priv;
+    ThreadData td;
+
+    for (int i = 0; i < s->nb_planes; i++) {
+        const int vsub = i == 1 || i == 2 ? s->vsub : 0;
+
+        init_thread_data(ctx, &td, in, out, i);
+        s->unsharp_rows(ctx, &td, 0, AV_CEIL_RSHIFT(y_start, vsub),
+                                     AV_CEIL_RSHIFT(y_end,   vsub));
+    }
+}
+
+static int rows_radius(AVFilterContext *ctx)
+{
+    UnsharpContext *s = ctx->priv;
+
+    return FFMAX3(s->luma.steps_y, s->chroma.steps_y << s->vsub, s->alpha.steps_y);
+}
+
 #define MAX_SCALEBITS 25
 
 static int set_filter_param(AVFilterContext *ctx, const char *name, const char *short_name,
@@ -297,6 +327,7 @@ static int config_input(AVFilterLink *inlink)
     s->bitdepth = desc->comp[0].depth;
     s->bps = s->bitdepth > 8 ? 2 : 1;
     s->unsharp_slice = s->bitdepth > 8 ? unsharp_slice_16 : unsharp_slice_8;
+    s->unsharp_rows  = s->bitdepth > 8 ? unsharp_slice_rows_16 : unsharp_slice_rows_8;
 
     // ensure (height / nb_threads) > 4 * steps_y,
     // so that we don't have too much overlap between two threads
@@ -400,9 +431,12 @@ const FFFilter ff_vf_unsharp = {
     .p.priv_class  = &unsharp_class,
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(UnsharpContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     .init          = init,
     .uninit        = uninit,
     FILTER_INPUTS(avfilter_vf_unsharp_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
+    .filter_rows   = filter_rows,
+    .rows_radius   = rows_radius,
 };
@@ -132,6 +132,7 @@ const FFFilter ff_vf_vflip = {
     .p.description = NULL_IF_CONFIG_SMALL("Flip the input video vertically."),
     .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
     .priv_size   = sizeof(FlipContext),
+    .flags_internal = FF_FILTER_FLAG_FRAME_STATELESS,
     FILTER_INPUTS(avfilter_vf_vflip_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
 };
@@ -50,10 +50,6 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
 {
     FilterLinkInternal *const li = ff_link_internal(link);
     AVFrame *frame = NULL;
-    int pool_width = 0;
-    int pool_height = 0;
-    int pool_align = 0;
-    enum AVPixelFormat pool_format = AV_PIX_FMT_NONE;
 
     if (li->l.hw_frames_ctx &&
         ((AVHWFramesContext*)li->l.hw_frames_ctx->data)->format == link->format) {
@@ -70,34 +66,8 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
         return frame;
     }
 
-    if (!li->frame_pool) {
-        li->frame_pool = ff_frame_pool_video_init(CONFIG_MEMORY_POISONING
-                                                     ? NULL
-                                                     : av_buffer_allocz,
-                                                  w, h, link->format, align);
-        if (!li->frame_pool)
-            return NULL;
-    } else {
-        if (ff_frame_pool_get_video_config(li->frame_pool,
-                                           &pool_width, &pool_height,
-                                           &pool_format, &pool_align) < 0) {
-            return NULL;
-        }
-
-        if (pool_width != w || pool_height != h ||
-            pool_format != link->format || pool_align != align) {
-
-            ff_frame_pool_uninit(&li->frame_pool);
-            li->frame_pool = ff_frame_pool_video_init(CONFIG_MEMORY_POISONING
-                                                         ? NULL
-                                                         : av_buffer_allocz,
-                                                      w, h, link->format, align);
-            if (!li->frame_pool)
-                return NULL;
-        }
-    }
-
-    frame = ff_frame_pool_get(li->frame_pool);
+    frame = ff_frame_pool_set_get_video(fffiltergraph(li->l.graph)->frame_pools,
+                                        w, h, link->format, align);
     if (!frame)
         return NULL;
 
@@ -116,6 +86,7 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
 {
     AVFrame *ret = NULL;
+    int profile = ff_filter_profile_alloc_start(link);
 
     FF_TPRINTF_START(NULL, get_video_buffer); ff_tlog_link(NULL, link, 1);
 
@@ -125,5 +96,8 @@ AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
     if (!ret)
         ret = ff_default_get_video_buffer(link, w, h);
 
+    if (profile)
+        ff_filter_profile_alloc_end(link, ret);
+
     return ret;
 }
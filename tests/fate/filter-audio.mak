@@ -435,6 +435,18 @@ FATE_AFILTER-yes += fate-filter-formats
 fate-filter-formats: libavfilter/tests/formats$(EXESUF)
 fate-filter-formats: CMD = run libavfilter/tests/formats$(EXESUF)
 
+FATE_AFILTER-yes += fate-filter-framepool
+fate-filter-framepool: libavfilter/tests/framepool$(EXESUF)
+fate-filter-framepool: CMD = run libavfilter/tests/framepool$(EXESUF)
+
+FATE_AFILTER-yes += fate-filter-graph
+fate-filter-graph: libavfilter/tests/graph$(EXESUF)
+fate-filter-graph: CMD = run libavfilter/tests/graph$(EXESUF)
+
+FATE_AFILTER-$(call ALLYES, COLOR_FILTER TRANSPOSE_FILTER EQ_FILTER NEGATE_FILTER NULLSINK_FILTER) += fate-filter-profile
+fate-filter-profile: libavfilter/tests/profile$(EXESUF)
+fate-filter-profile: CMD = run libavfilter/tests/profile$(EXESUF)
+
 FATE_AFILTER-yes := $(if $(call FRAMECRC), $(FATE_AFILTER-yes))
 FATE_SAMPLES_AVCONV += $(FATE_AFILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_AFILTER-yes)
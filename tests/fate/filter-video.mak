@@ -178,6 +178,18 @@ FATE_FILTER-$(call FILTERFRAMECRC, FRAMERATE TESTSRC2 FORMAT SCALE) += fate-filt
 fate-filter-framerate-12bit-up: CMD = framecrc -lavfi testsrc2=r=50:d=1,format=pix_fmts=yuv422p12le,scale,framerate=fps=60,scale -t 1 -pix_fmt yuv422p12le
 fate-filter-framerate-12bit-down: CMD = framecrc -lavfi testsrc2=r=60:d=1,format=pix_fmts=yuv422p12le,scale,framerate=fps=50,scale -t 1 -pix_fmt yuv422p12le
 
+FATE_FILTER-$(call FILTERFRAMECRC, FRAMEPARALLEL TESTSRC2 HFLIP NEGATE) += fate-filter-frameparallel
+fate-filter-frameparallel: CMD = framecrc -lavfi testsrc2=r=7:d=1,frameparallel=filters=hflip\\,negate:threads=3
+
+FATE_FILTER-$(call FILTERFRAMECRC, LADDER TESTSRC2 TRIM NULL) += fate-filter-ladder
+fate-filter-ladder: CMD = framecrc -lavfi "testsrc2=r=7:d=1,ladder=sizes=160x120|80x60:flags=bicubic+accurate_rnd+bitexact[a][b];[a]trim=end_frame=3;[b]null" -sws_flags +accurate_rnd+bitexact
+
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT CROP EQ HUE LUTYUV NEGATE) += fate-filter-fused-yuv420p
+fate-filter-fused-yuv420p: CMD = framecrc -lavfi testsrc2=r=5:d=1,format=yuv420p,crop=316:238:0:0,eq=contrast=1.3:saturation=1.2,hue=h=30:b=1,lutyuv=y=negval,negate -filter_threads 3
+
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT CROP UNSHARP LUTYUV SOBEL NEGATE) += fate-filter-fused-stripes
+fate-filter-fused-stripes: CMD = framecrc -filter_fuse stripes -lavfi testsrc2=r=5:d=1,format=yuv420p,crop=316:238:0:0,unsharp=7:7:1.5:5:5:0.5,lutyuv=y=negval,sobel,negate
+
 FATE_FILTER-$(call FILTERFRAMECRC, MINTERPOLATE TESTSRC2) += fate-filter-minterpolate-up fate-filter-minterpolate-down
 fate-filter-minterpolate-up: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=10 -t 1
 fate-filter-minterpolate-down: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=1 -t 1
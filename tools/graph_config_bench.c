@@ -0,0 +1,270 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the time needed to parse and configure a filtergraph, either read
+ * from a file or generated as a chain of filters, and optionally the time
+ * needed to run it to completion.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/bprint.h"
+#include "libavutil/error.h"
+#include "libavutil/file.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+static void usage(void)
+{
+    printf("Measure the configuration time of a libavfilter graph.\n");
+    printf("Usage: graph_config_bench [OPTIONS]\n");
+    printf("\n"
+           "Options:\n"
+           "-i INFILE         read the graph from INFILE\n"
+           "-n COUNT          generate a chain of COUNT filters, 500 by default\n"
+           "-f FILTER         filter of the generated chain, hflip by default\n"
+           "-s SOURCE         source of the generated chain, testsrc2=d=1 by default\n"
+           "-r RUNS           number of runs, 5 by default\n"
+           "-e                also run the graph until EOF\n"
+           "-h                print this help\n");
+}
+
+typedef struct BenchResult {
+    int64_t  parse_time;
+    int64_t  config_time;
+    int64_t  exec_time;
+    uint64_t nb_frames;
+    unsigned nb_filters;
+} BenchResult;
+
+/* terminate the open outputs of the graph with buffer sinks */
+static int add_sinks(AVFilterGraph *graph, AVFilterInOut *outputs,
+                     AVFilterContext ***sinks, int *nb_sinks)
+{
+    for (AVFilterInOut *cur = outputs; cur; cur = cur->next) {
+        enum AVMediaType type = avfilter_pad_get_type(cur->filter_ctx->output_pads,
+                                                      cur->pad_idx);
+        const char *name = type == AVMEDIA_TYPE_AUDIO ? "abuffersink" : "buffersink";
+        AVFilterContext *sink, **tmp;
+        int ret;
+
+        ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name(name),
+                                           NULL, NULL, NULL, graph);
+        if (ret < 0)
+            return ret;
+        ret = avfilter_link(cur->filter_ctx, cur->pad_idx, sink, 0);
+        if (ret < 0)
+            return ret;
+
+        tmp = av_realloc_array(*sinks, *nb_sinks + 1, sizeof(**sinks));
+        if (!tmp)
+            return AVERROR(ENOMEM);
+        *sinks = tmp;
+        (*sinks)[(*nb_sinks)++] = sink;
+    }
+    return 0;
+}
+
+static int exec_graph(AVFilterGraph *graph, AVFilterContext **sinks, int nb_sinks,
+                      uint64_t *nb_frames)
+{
+    AVFrame *frame = av_frame_alloc();
+    int ret;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    do {
+        ret = avfilter_graph_request_oldest(graph);
+        for (int i = 0; i < nb_sinks; i++) {
+            while (av_buffersink_get_frame_flags(sinks[i], frame,
+                                                 AV_BUFFERSINK_FLAG_NO_REQUEST) >= 0) {
+                (*nb_frames)++;
+                av_frame_unref(frame);
+            }
+        }
+    } while (ret >= 0);
+
+    av_frame_free(&frame);
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+static int run(const char *graph_string, int exec, BenchResult *res)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    AVFilterContext **sinks = NULL;
+    int nb_sinks = 0;
+    int64_t t0, t1, t2, t3;
+    int ret;
+
+    if (!graph)
+        return AVERROR(ENOMEM);
+    graph->nb_threads = 1;
+
+    t0  = av_gettime_relative();
+    ret = avfilter_graph_parse2(graph, graph_string, &inputs, &outputs);
+    if (ret >= 0 && inputs) {
+        fprintf(stderr, "The graph must not have open inputs\n");
+        ret = AVERROR(EINVAL);
+    }
+    if (ret >= 0)
+        ret = add_sinks(graph, outputs, &sinks, &nb_sinks);
+    t1  = av_gettime_relative();
+    if (ret < 0) {
+        fprintf(stderr, "Failed to parse the graph description\n");
+        goto end;
+    }
+    ret = avfilter_graph_config(graph, NULL);
+    t2  = av_gettime_relative();
+    if (ret < 0) {
+        fprintf(stderr, "Failed to configure the graph\n");
+        goto end;
+    }
+
+    res->nb_frames = 0;
+    if (exec) {
+        ret = exec_graph(graph, sinks, nb_sinks, &res->nb_frames);
+        if (ret < 0) {
+            fprintf(stderr, "Failed to run the graph: %s\n", av_err2str(ret));
+            goto end;
+        }
+    }
+    t3 = av_gettime_relative();
+
+    res->parse_time  = t1 - t0;
+    res->config_time = t2 - t1;
+    res->exec_time   = t3 - t2;
+    res->nb_filters  = graph->nb_filters;
+end:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    av_freep(&sinks);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *infilename = NULL;
+    const char *filter     = "hflip";
+    const char *source     = "testsrc2=d=1";
+    int count = 500, runs = 5, exec = 0;
+    BenchResult best = { INT64_MAX, INT64_MAX, INT64_MAX };
+    AVBPrint bp;
+    int c, i, ret;
+
+    while ((c = getopt(argc, argv, "hi:n:f:s:r:e")) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            return 0;
+        case 'i':
+            infilename = optarg;
+            break;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 's':
+            source = optarg;
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 'e':
+            exec = 1;
+            break;
+        case '?':
+            return 1;
+        }
+    }
+    if (count < 0 || runs <= 0) {
+        usage();
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    if (infilename) {
+        uint8_t *buf;
+        size_t size;
+
+        ret = av_file_map(infilename, &buf, &size, 0, NULL);
+        if (ret < 0) {
+            fprintf(stderr, "Failed to read input file '%s': %s\n",
+                    infilename, av_err2str(ret));
+            return 1;
+        }
+        av_bprint_append_data(&bp, buf, size);
+        av_file_unmap(buf, size);
+    } else {
+        av_bprintf(&bp, "%s", source);
+        for (i = 0; i < count; i++)
+            av_bprintf(&bp, ",%s", filter);
+    }
+    if (!av_bprint_is_complete(&bp)) {
+        fprintf(stderr, "Memory allocation failure\n");
+        return 1;
+    }
+
+    for (i = 0; i < runs; i++) {
+        BenchResult res;
+
+        ret = run(bp.str, exec, &res);
+        if (ret < 0) {
+            av_bprint_finalize(&bp, NULL);
+            return 1;
+        }
+        best.parse_time  = FFMIN(best.parse_time,  res.parse_time);
+        best.config_time = FFMIN(best.config_time, res.config_time);
+        best.exec_time   = FFMIN(best.exec_time,   res.exec_time);
+        best.nb_frames   = res.nb_frames;
+        best.nb_filters  = res.nb_filters;
+    }
+
+    printf("%u filters: parse %.3f ms, config %.3f ms (best of %d runs)\n",
+           best.nb_filters, best.parse_time / 1000.0, best.config_time / 1000.0, runs);
+    if (exec && best.nb_frames)
+        printf("run %.3f ms, %"PRIu64" frames out, %.1f ns per filter and frame\n",
+               best.exec_time / 1000.0, best.nb_frames,
+               best.exec_time * 1000.0 / (best.nb_frames * best.nb_filters));
+
+    av_bprint_finalize(&bp, NULL);
+    return 0;
+}
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+
+import argparse
+import concurrent.futures
+import logging
+import math
+import os
+import shlex
+import subprocess
+import tempfile
+from fractions import Fraction
+
+HELP = '''
+Transcode a seekable input by splitting it into segments encoded in parallel.
+
+The command uses ffprobe to find the keyframes of the first video stream of
+the input and cuts it into as many segments of roughly equal duration,
+starting at keyframes. Every segment is encoded by its own ffmpeg process,
+while another one encodes the audio streams of the whole input. The encoded
+segments are finally joined with the concat demuxer and muxed together with
+the audio, without re-encoding.
+
+This scales with the number of CPU cores even with encoders which do not use
+multiple threads well. Since every segment is encoded independently, rate
+control and GOP structure restart at each segment boundary. Subtitle and data
+streams are not transcoded.
+
+ffmpeg encoding arguments can be passed through the extra arguments
+after options, for example as in:
+split_transcode.py -i input.mkv -o output.mkv -- -c:v mpeg2video -b:v 8M -c:a aac
+'''
+
+logging.basicConfig(format='split_transcode|%(levelname)s> %(message)s', level=logging.INFO)
+log = logging.getLogger()
+
+
+class Formatter(
+    argparse.ArgumentDefaultsHelpFormatter, argparse.RawDescriptionHelpFormatter
+):
+    pass
+
+
+def _run_command(cmd, dry_run=False):
+    log.info(f"Running command:\n$ {shlex.join(cmd)}")
+    if not dry_run:
+        return subprocess.run(cmd, check=True, stdout=subprocess.PIPE, text=True)
+
+
+def _probe(args, entries, streams=None):
+    cmd = [args.ffprobe, '-v', 'error', '-of', 'csv=p=0']
+    if streams:
+        cmd += ['-select_streams', streams]
+    cmd += ['-show_entries', entries, args.input]
+    return [line.split(',') for line in _run_command(cmd).stdout.splitlines() if line]
+
+
+def _timestamp(t):
+    us = math.floor(t * 1000000)
+    return f'{us // 1000000}.{us % 1000000:06d}'
+
+
+def split_points(args):
+    '''Return the start times of the segments, relative to the start time of the
+    input like the input -ss option. Every segment starts at a keyframe, except
+    the first one, which starts at the first video frame.'''
+    tb = Fraction(_probe(args, 'stream=time_base', 'v:0')[0][0])
+    start_time, duration, *_ = _probe(args, 'format=start_time,duration')[0]
+    start = Fraction(start_time) if start_time != 'N/A' else Fraction(0)
+    duration = Fraction(duration)
+
+    first = None
+    keyframes = []
+    for pts, flags, *_ in _probe(args, 'packet=pts,flags', 'v:0'):
+        if pts == 'N/A':
+            continue
+        pts = int(pts) * tb - start
+        first = pts if first is None else min(first, pts)
+        if flags.startswith('K'):
+            keyframes.append(pts)
+    if first is None:
+        return [Fraction(0)]
+    keyframes.sort()
+
+    points = [max(first, Fraction(0))]
+    for i in range(1, args.jobs):
+        target = duration * i / args.jobs
+        kf = next((k for k in keyframes if k >= target), None)
+        if kf is None:
+            break
+        if kf > points[-1]:
+            points.append(kf)
+    return points
+
+
+def split_transcode():
+    parser = argparse.ArgumentParser(description=HELP, formatter_class=Formatter)
+    parser.add_argument('--input', '-i', required=True, help='specify input file')
+    parser.add_argument('--output', '-o', required=True, help='specify output file')
+    parser.add_argument('--jobs', '-j', type=int, default=os.cpu_count() or 1,
+                        help='specify the number of segments encoded in parallel')
+    parser.add_argument('--ffmpeg', default='ffmpeg', help='specify the ffmpeg executable')
+    parser.add_argument('--ffprobe', default='ffprobe', help='specify the ffprobe executable')
+    parser.add_argument('--dry-run', '-n', help='simulate commands', action='store_true')
+    parser.add_argument('encode_arguments', nargs='*', help='specify encode options used for the segments and the audio')
+
+    args = parser.parse_args()
+    if args.jobs < 1:
+        parser.error('the number of jobs must be positive')
+
+    points = split_points(args)
+    has_audio = bool(_probe(args, 'stream=index', 'a'))
+    log.info(f"Splitting '{args.input}' into {len(points)} segments")
+
+    ffmpeg = [args.ffmpeg, '-nostdin', '-v', 'error', '-y']
+
+    with tempfile.TemporaryDirectory(prefix='split_transcode') as tmpdir:
+        cmds = []
+        segments = []
+        for i, start in enumerate(points):
+            segment = os.path.join(tmpdir, f'segment{i:04d}.mkv')
+            # timestamps are rounded down: -ss then keeps the frame at start,
+            # while -t, which counts from that frame, drops the next segment's
+            cmd = ffmpeg + ['-ss', _timestamp(start), '-i', args.input]
+            if i + 1 < len(points):
+                cmd += ['-t', _timestamp(points[i + 1] - start)]
+            cmd += ['-map', '0:v:0'] + args.encode_arguments + [segment]
+            cmds.append(cmd)
+            segments.append(segment)
+
+        if has_audio:
+            audio = os.path.join(tmpdir, 'audio.mkv')
+            cmds.append(ffmpeg + ['-i', args.input, '-map', '0:a'] +
+                        args.encode_arguments + [audio])
+
+        # the audio is encoded in one piece and takes the longest, start it first
+        with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+            list(pool.map(lambda cmd: _run_command(cmd, args.dry_run), reversed(cmds)))
+
+        concat_list = os.path.join(tmpdir, 'segments.txt')
+        with open(concat_list, 'w') as f:
+            for segment in segments:
+                escaped = segment.replace("'", "'\\''")
+                f.write(f"file '{escaped}'\n")
+
+        # the concat demuxer starts at 0, restore the delay of the video
+        cmd = ffmpeg + ['-itsoffset', _timestamp(points[0]),
+                        '-f', 'concat', '-safe', '0', '-i', concat_list]
+        if has_audio:
+            cmd += ['-i', audio, '-map', '0:v', '-map', '1:a']
+        cmd += ['-c', 'copy', args.output]
+        _run_command(cmd, args.dry_run)
+
+
+if __name__ == '__main__':
+    split_transcode()